@@ -0,0 +1,290 @@
+#include <algorithm>
+#include <atomic>
+#include <brainiac.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * Position of the standard suite along with its known leaf counts by depth
+ */
+struct Position {
+    std::string name;
+    std::string fen;
+    std::vector<uint64_t> counts;
+};
+
+const std::vector<Position> suite = {
+    {"start",
+     "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+     {20, 400, 8902, 197281, 4865609, 119060324}},
+    {"kiwipete",
+     "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+     {48, 2039, 97862, 4085603, 193690690}},
+    {"position3",
+     "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+     {14, 191, 2812, 43238, 674624, 11030083}},
+    {"position4",
+     "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+     {6, 264, 9467, 422333, 15833292}},
+    {"position5",
+     "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+     {44, 1486, 62379, 2103487, 89941194}},
+    {"position6",
+     "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 "
+     "10",
+     {46, 2079, 89890, 3894594, 164075551}},
+};
+
+/**
+ * Leaf counts of positions by hash and depth, shared by all threads
+ *
+ * Entries are written without locks, the check word is the key mixed with
+ * the count so a torn write reads as a miss.
+ */
+class PerftTable {
+    struct Slot {
+        std::atomic<uint64_t> check;
+        std::atomic<uint64_t> count;
+    };
+
+    std::unique_ptr<Slot[]> _slots;
+    size_t _mask = 0;
+
+    static uint64_t mix(uint64_t hash, int depth) {
+        return hash ^ (depth * 0x9e3779b97f4a7c15ULL);
+    }
+
+  public:
+    /**
+     * Create a table of about some number of bytes, or none if zero
+     */
+    PerftTable(size_t bytes) {
+        if (bytes < sizeof(Slot)) return;
+        size_t count = 1;
+        while (count * 2 * sizeof(Slot) <= bytes) {
+            count *= 2;
+        }
+        _slots = std::make_unique<Slot[]>(count);
+        _mask = count - 1;
+        for (size_t i = 0; i < count; i++) {
+            _slots[i].check = 0;
+            _slots[i].count = 0;
+        }
+    }
+
+    bool probe(uint64_t hash, int depth, uint64_t &count) {
+        if (!_slots) return false;
+        uint64_t key = mix(hash, depth);
+        Slot &slot = _slots[key & _mask];
+        uint64_t stored = slot.count.load(std::memory_order_relaxed);
+        if ((slot.check.load(std::memory_order_relaxed) ^ stored) != key) {
+            return false;
+        }
+        count = stored;
+        return true;
+    }
+
+    void store(uint64_t hash, int depth, uint64_t count) {
+        if (!_slots) return;
+        uint64_t key = mix(hash, depth);
+        Slot &slot = _slots[key & _mask];
+        slot.check.store(key ^ count, std::memory_order_relaxed);
+        slot.count.store(count, std::memory_order_relaxed);
+    }
+};
+
+/**
+ * Count the leaves of the move tree of a position to a depth
+ *
+ * The last ply is counted from the length of the move list without playing
+ * the moves.
+ */
+uint64_t perft(brainiac::Board &board, int depth, PerftTable &table) {
+    std::vector<brainiac::Move> moves = board.get_moves();
+    if (depth <= 1) return depth == 1 ? moves.size() : 1;
+
+    uint64_t hash = board.get_hash();
+    uint64_t count = 0;
+    if (table.probe(hash, depth, count)) return count;
+    for (brainiac::Move &move : moves) {
+        board.make_move(move);
+        count += perft(board, depth - 1, table);
+        board.undo_move();
+    }
+    table.store(hash, depth, count);
+    return count;
+}
+
+/**
+ * Leaf count below each root move
+ */
+struct Divide {
+    std::string move;
+    uint64_t count;
+};
+
+/**
+ * Count the leaves below each root move, with the root moves split between
+ * threads that each play on their own copy of the board
+ */
+std::vector<Divide> perft_divide(brainiac::Board &board,
+                                 int depth,
+                                 int threads,
+                                 PerftTable &table) {
+    std::vector<brainiac::Move> moves = board.get_moves();
+    std::vector<Divide> divide(moves.size());
+    std::atomic<size_t> next = 0;
+    std::vector<std::thread> workers;
+    for (int i = 0; i < std::max(threads, 1); i++) {
+        workers.emplace_back([&]() {
+            brainiac::Board copy = board;
+            for (size_t j = next++; j < moves.size(); j = next++) {
+                copy.make_move(moves[j]);
+                divide[j] = {moves[j].standard_notation(),
+                             perft(copy, depth - 1, table)};
+                copy.undo_move();
+            }
+        });
+    }
+    for (std::thread &worker : workers) {
+        worker.join();
+    }
+    return divide;
+}
+
+/**
+ * Timed perft of one position of the suite
+ */
+struct Result {
+    std::string name;
+    int depth;
+    uint64_t nodes;
+    uint64_t expected;
+    double seconds;
+};
+
+/**
+ * Entry function
+ *
+ * Usage: perft [max depth] [threads] [hash MB] [json output path]
+ *        perft divide [fen] [depth] [threads] [hash MB]
+ *
+ * Without divide, every position of the standard suite is counted up to the
+ * max depth, or the deepest known count if less, and checked against the
+ * known counts. A hash of zero times plain move generation.
+ */
+int main(int argc, char **argv) {
+    brainiac::init();
+    int threads = std::thread::hardware_concurrency();
+    if (argc > 1 && std::strcmp(argv[1], "divide") == 0) {
+        std::string fen = argc > 2 ? argv[2] : suite[0].fen;
+        int depth = argc > 3 ? std::atoi(argv[3]) : 4;
+        threads = argc > 4 ? std::atoi(argv[4]) : threads;
+        size_t hash_mb = argc > 5 ? std::atoll(argv[5]) : 0;
+        PerftTable table(hash_mb << 20);
+        brainiac::Board board(fen);
+
+        auto start = std::chrono::steady_clock::now();
+        std::vector<Divide> divide =
+            perft_divide(board, std::max(depth, 1), threads, table);
+        double seconds = std::chrono::duration<double>(
+                             std::chrono::steady_clock::now() - start)
+                             .count();
+        std::sort(divide.begin(), divide.end(), [](auto &a, auto &b) {
+            return a.move < b.move;
+        });
+        uint64_t total = 0;
+        for (Divide &entry : divide) {
+            std::printf("%s: %llu\n",
+                        entry.move.c_str(),
+                        static_cast<unsigned long long>(entry.count));
+            total += entry.count;
+        }
+        std::printf("\nMoves: %zu\nNodes: %llu\nTime: %.3f s\n",
+                    divide.size(),
+                    static_cast<unsigned long long>(total),
+                    seconds);
+        return 0;
+    }
+
+    int max_depth = argc > 1 ? std::atoi(argv[1]) : 5;
+    threads = argc > 2 ? std::atoi(argv[2]) : threads;
+    size_t hash_mb = argc > 3 ? std::atoll(argv[3]) : 0;
+    std::string output = argc > 4 ? argv[4] : "bench_perft.json";
+    if (max_depth < 1) {
+        std::cerr << "Usage: perft [max depth] [threads] [hash MB] "
+                     "[json output path]\n"
+                     "       perft divide [fen] [depth] [threads] [hash MB]\n"
+                     "The depth must be at least 1\n";
+        return 1;
+    }
+
+    std::vector<Result> results;
+    bool passed = true;
+    for (const Position &position : suite) {
+        int depth = std::min<int>(max_depth, position.counts.size());
+
+        // Each position starts on an empty table so timings are comparable
+        PerftTable table(hash_mb << 20);
+        brainiac::Board board(position.fen);
+        auto start = std::chrono::steady_clock::now();
+        std::vector<Divide> divide = perft_divide(board, depth, threads, table);
+        double seconds = std::chrono::duration<double>(
+                             std::chrono::steady_clock::now() - start)
+                             .count();
+
+        uint64_t nodes = 0;
+        for (Divide &entry : divide) {
+            nodes += entry.count;
+        }
+        uint64_t expected = position.counts[depth - 1];
+        passed &= nodes == expected;
+        results.push_back({position.name, depth, nodes, expected, seconds});
+    }
+
+    std::printf("%-10s %5s %12s %12s %10s %10s\n",
+                "position",
+                "depth",
+                "nodes",
+                "expected",
+                "seconds",
+                "Mnodes/s");
+    std::ofstream json(output);
+    json << "[\n";
+    uint64_t total_nodes = 0;
+    double total_seconds = 0;
+    for (int i = 0; i < results.size(); i++) {
+        const Result &r = results[i];
+        double mnps = r.seconds ? r.nodes / r.seconds / 1e6 : 0;
+        std::printf("%-10s %5d %12llu %12llu %10.3f %10.2f%s\n",
+                    r.name.c_str(),
+                    r.depth,
+                    static_cast<unsigned long long>(r.nodes),
+                    static_cast<unsigned long long>(r.expected),
+                    r.seconds,
+                    mnps,
+                    r.nodes == r.expected ? "" : "  MISMATCH");
+        json << "  {\"position\": \"" << r.name << "\", \"depth\": " << r.depth
+             << ", \"nodes\": " << r.nodes << ", \"expected\": " << r.expected
+             << ", \"seconds\": " << r.seconds
+             << ", \"nodes_per_second\": " << (mnps * 1e6) << "}"
+             << (i + 1 < results.size() ? ",\n" : "\n");
+        total_nodes += r.nodes;
+        total_seconds += r.seconds;
+    }
+    json << "]\n";
+    std::printf("Total: %.2f Mnodes/s on %d threads, hash %zu MB\n",
+                total_seconds ? total_nodes / total_seconds / 1e6 : 0,
+                threads,
+                hash_mb);
+    std::cout << "Results written to " << output << "\n";
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,302 @@
+// Expose the internal stages of the png writer to time them individually,
+// the implementation is static so it does not clash with image.cpp
+#define STB_IMAGE_WRITE_STATIC
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "util/stb_image_write.h"
+#undef STB_IMAGE_WRITE_IMPLEMENTATION
+
+#include <brainiac.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "render.h"
+
+/**
+ * Positions every stage is measured on
+ */
+const std::vector<std::string> fens = {
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+    "r1bq1rk1/pp2bppp/2n1pn2/3p4/2PP4/2N1PN2/PP3PPP/R2QKB1R w KQ - 0 8",
+    "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+    "8/8/8/4k3/8/8/8/4K3 w - - 0 1",
+};
+
+/**
+ * Measurement of one stage on one position
+ */
+struct Result {
+    std::string stage;
+    int position;
+    uint64_t iterations;
+    double ns_per_op;
+    double ns_per_pixel;
+    double mb_per_second;
+    uint64_t bytes_out;
+};
+
+/**
+ * Run a stage repeatedly for at least a minimum duration and time it
+ */
+Result measure(std::string stage,
+               int position,
+               uint64_t pixels,
+               uint64_t bytes_in,
+               std::function<uint64_t()> run) {
+    using clock = std::chrono::steady_clock;
+    uint64_t bytes_out = run(); // Warm up caches and lazy state
+    uint64_t iterations = 0;
+    auto start = clock::now();
+    std::chrono::duration<double> elapsed(0);
+    while (iterations < 3 || elapsed.count() < 0.25) {
+        bytes_out = run();
+        iterations++;
+        elapsed = clock::now() - start;
+    }
+    double ns = elapsed.count() * 1e9 / iterations;
+    return {
+        stage,
+        position,
+        iterations,
+        ns,
+        pixels ? ns / pixels : 0,
+        bytes_in ? bytes_in / (ns / 1e9) / 1e6 : 0,
+        bytes_out,
+    };
+}
+
+/**
+ * Benchmark each stage of the render pipeline on a position
+ */
+void bench_position(int position,
+                    std::string image_dir,
+                    std::vector<Result> &results) {
+    brainiac::Board board(fens[position]);
+    const int size = BoardRenderer::size;
+    const int cell = BoardRenderer::cell_size;
+    const uint64_t canvas_pixels = size * size;
+    const uint64_t canvas_bytes = canvas_pixels * 4;
+
+    results.push_back(measure("sprite_load", position, 0, 0, [&]() {
+        BoardRenderer renderer(image_dir);
+        return 0;
+    }));
+
+    Image canvas(size, size);
+    results.push_back(
+        measure("fill", position, canvas_pixels, canvas_bytes, [&]() {
+            canvas.fill({0.08, 0.08, 0.08, 1.0});
+            return 0;
+        }));
+
+    Image tile(image_dir + "brown0.png");
+    results.push_back(measure("tile_blits",
+                              position,
+                              64 * cell * cell,
+                              64 * cell * cell * 4,
+                              [&]() {
+                                  for (int i = 0; i < 64; i++) {
+                                      canvas.blit(&tile,
+                                                  (i % 8) * cell + 32,
+                                                  (i / 8) * cell + 32);
+                                  }
+                                  return 0;
+                              }));
+
+    std::vector<std::unique_ptr<Image>> pieces;
+    for (int i = 0; i < 12; i++) {
+        pieces.push_back(
+            std::make_unique<Image>(image_dir + std::to_string(i) + ".png"));
+    }
+    uint64_t piece_pixels = 0;
+    for (int rank = 0; rank < 8; rank++) {
+        for (int file = 0; file < 8; file++) {
+            brainiac::Piece piece = board.get_at_coords(rank, file);
+            if (piece.is_empty()) continue;
+            Image *image = pieces[piece.get_index()].get();
+            piece_pixels += image->width * image->height;
+        }
+    }
+    results.push_back(measure("piece_blends",
+                              position,
+                              piece_pixels,
+                              piece_pixels * 4,
+                              [&]() {
+                                  for (int rank = 0; rank < 8; rank++) {
+                                      for (int file = 0; file < 8; file++) {
+                                          brainiac::Piece piece =
+                                              board.get_at_coords(rank, file);
+                                          if (piece.is_empty()) continue;
+                                          canvas.draw(
+                                              pieces[piece.get_index()].get(),
+                                              file * cell + 32,
+                                              (7 - rank) * cell + 32);
+                                      }
+                                  }
+                                  return 0;
+                              }));
+
+    // The stages of the png writer run on a fully rendered board
+    BoardRenderer renderer(image_dir);
+    std::string png = renderer.render(0, board);
+    int width, height, channels;
+    unsigned char *pixels =
+        stbi_load_from_memory(reinterpret_cast<unsigned char *>(png.data()),
+                              png.size(),
+                              &width,
+                              &height,
+                              &channels,
+                              4);
+
+    // Try every filter on each row and keep the cheapest, as stb does
+    int stride = width * 4;
+    std::vector<unsigned char> filtered((stride + 1) * height);
+    std::vector<signed char> line(stride);
+    results.push_back(
+        measure("png_filter", position, canvas_pixels, canvas_bytes, [&]() {
+            for (int y = 0; y < height; y++) {
+                int best_filter = 0;
+                int best_estimate = 0x7fffffff;
+                for (int filter = 0; filter < 5; filter++) {
+                    stbiw__encode_png_line(pixels,
+                                           stride,
+                                           width,
+                                           height,
+                                           y,
+                                           4,
+                                           filter,
+                                           line.data());
+                    int estimate = 0;
+                    for (int i = 0; i < stride; i++) {
+                        estimate += std::abs(line[i]);
+                    }
+                    if (estimate < best_estimate) {
+                        best_estimate = estimate;
+                        best_filter = filter;
+                    }
+                }
+                stbiw__encode_png_line(pixels,
+                                       stride,
+                                       width,
+                                       height,
+                                       y,
+                                       4,
+                                       best_filter,
+                                       line.data());
+                filtered[y * (stride + 1)] = best_filter;
+                std::memcpy(&filtered[y * (stride + 1) + 1],
+                            line.data(),
+                            stride);
+            }
+            return filtered.size();
+        }));
+
+    std::vector<unsigned char> compressed;
+    results.push_back(measure("deflate",
+                              position,
+                              canvas_pixels,
+                              filtered.size(),
+                              [&]() {
+                                  int length = 0;
+                                  unsigned char *zlib = stbi_zlib_compress(
+                                      filtered.data(),
+                                      filtered.size(),
+                                      &length,
+                                      stbi_write_png_compression_level);
+                                  compressed.assign(zlib, zlib + length);
+                                  STBIW_FREE(zlib);
+                                  return compressed.size();
+                              }));
+
+    results.push_back(measure("crc",
+                              position,
+                              0,
+                              compressed.size(),
+                              [&]() {
+                                  volatile unsigned int crc =
+                                      stbiw__crc32(compressed.data(),
+                                                   compressed.size());
+                                  (void)crc;
+                                  return 0;
+                              }));
+    stbi_image_free(pixels);
+
+    results.push_back(measure("generate_image_cold",
+                              position,
+                              canvas_pixels,
+                              canvas_bytes,
+                              [&]() {
+                                  BoardRenderer cold(image_dir);
+                                  return cold.render(0, board).size();
+                              }));
+
+    // Alternate with the starting position so the dirty cells are redrawn
+    brainiac::Board start(fens[0]);
+    bool flip = false;
+    results.push_back(measure("generate_image_warm",
+                              position,
+                              canvas_pixels,
+                              canvas_bytes,
+                              [&]() {
+                                  flip = !flip;
+                                  brainiac::Board &next =
+                                      flip ? board : start;
+                                  return renderer.render(0, next).size();
+                              }));
+}
+
+/**
+ * Entry function
+ *
+ * Usage: bench_render [image directory] [json output path]
+ */
+int main(int argc, char **argv) {
+    std::string image_dir = argc > 1 ? argv[1] : "../images/";
+    std::string output = argc > 2 ? argv[2] : "bench_render.json";
+    brainiac::init();
+
+    std::vector<Result> results;
+    for (int i = 0; i < fens.size(); i++) {
+        bench_position(i, image_dir, results);
+    }
+
+    std::printf("%-20s %4s %10s %14s %10s %10s %10s\n",
+                "stage",
+                "pos",
+                "iters",
+                "ns/op",
+                "ns/px",
+                "MB/s",
+                "bytes out");
+    std::ofstream json(output);
+    json << "[\n";
+    for (int i = 0; i < results.size(); i++) {
+        const Result &r = results[i];
+        std::printf("%-20s %4d %10llu %14.0f %10.3f %10.1f %10llu\n",
+                    r.stage.c_str(),
+                    r.position,
+                    static_cast<unsigned long long>(r.iterations),
+                    r.ns_per_op,
+                    r.ns_per_pixel,
+                    r.mb_per_second,
+                    static_cast<unsigned long long>(r.bytes_out));
+        json << "  {\"stage\": \"" << r.stage << "\", \"fen\": \""
+             << fens[r.position] << "\", \"iterations\": " << r.iterations
+             << ", \"ns_per_op\": " << r.ns_per_op
+             << ", \"ns_per_pixel\": " << r.ns_per_pixel
+             << ", \"mb_per_second\": " << r.mb_per_second
+             << ", \"bytes_out\": " << r.bytes_out << "}"
+             << (i + 1 < results.size() ? ",\n" : "\n");
+    }
+    json << "]\n";
+    std::cout << "Results written to " << output << "\n";
+    return 0;
+}
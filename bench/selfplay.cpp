@@ -0,0 +1,371 @@
+#include <algorithm>
+#include <atomic>
+#include <brainiac.h>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "engine.h"
+#include "table.h"
+
+/**
+ * Balanced openings every game starts from, each played with both colors
+ */
+const std::vector<std::string> openings = {
+    "r1bqkbnr/1ppp1ppp/p1n5/1B2p3/4P3/5N2/PPPP1PPP/RNBQK2R w KQkq - 0 4",
+    "r1bqk1nr/pppp1ppp/2n5/2b1p3/2B1P3/5N2/PPPP1PPP/RNBQK2R w KQkq - 4 4",
+    "rnbqkb1r/pp2pppp/3p1n2/8/3NP3/2N5/PPP2PPP/R1BQKB1R b KQkq - 2 5",
+    "r1bqkbnr/pp1ppppp/2n5/2p5/4P3/2N3P1/PPPP1P1P/R1BQKBNR b KQkq - 0 3",
+    "rnbqkbnr/ppp2ppp/4p3/3p4/3PP3/2N5/PPP2PPP/R1BQKBNR b KQkq - 1 3",
+    "rnbqkbnr/pp2pppp/2p5/3pP3/3P4/8/PPP2PPP/RNBQKBNR b KQkq - 0 3",
+    "rnbqkb1r/ppp1pp1p/3p1np1/8/3PP3/2N5/PPP2PPP/R1BQKBNR w KQkq - 0 4",
+    "rnbqkb1r/ppp1pppp/3p4/3nP3/3P4/8/PPP2PPP/RNBQKBNR w KQkq - 0 4",
+    "rnbqkb1r/ppp2ppp/4pn2/3p4/2PP4/2N5/PP2PPPP/R1BQKBNR w KQkq - 2 4",
+    "rnbqkb1r/pp2pppp/2p2n2/3p4/2PP4/5N2/PP2PPPP/RNBQKB1R w KQkq - 2 4",
+    "rnbqkb1r/ppp1pppp/5n2/8/2pP4/5N2/PP2PPPP/RNBQKB1R w KQkq - 2 4",
+    "rnbqk2r/ppp1ppbp/3p1np1/8/2PPP3/2N5/PP3PPP/R1BQKBNR w KQkq - 0 5",
+    "rnbqk2r/pppp1ppp/4pn2/8/1bPP4/2N5/PP2PPPP/R1BQKBNR w KQkq - 2 4",
+    "rnbqkb1r/pp1p1ppp/4pn2/2pP4/2P5/8/PP2PPPP/RNBQKBNR w KQkq - 0 4",
+    "rnbqkb1r/pppp1ppp/5n2/4p3/2P5/2N3P1/PP1PPP1P/R1BQKBNR b KQkq - 0 3",
+    "rnbqkb1r/ppp2ppp/4pn2/3p4/8/5NP1/PPPPPPBP/RNBQK2R w KQkq - 0 4",
+};
+
+/**
+ * Games still going after this many plies are scored as draws
+ */
+constexpr int max_game_plies = 300;
+
+/**
+ * Search settings of one side of the match
+ */
+struct Config {
+    std::string name;
+    int depth = max_ply / 2;
+    uint64_t nodes = 0;
+    int threads = 1;
+    int noise = 0;
+    size_t table_mb = 16;
+};
+
+/**
+ * Clock of every game, in milliseconds
+ */
+struct TimeControl {
+    int64_t base = 10000;
+    int64_t increment = 100;
+};
+
+/**
+ * Statistics gathered for one side over all its moves
+ */
+struct Stats {
+    uint64_t moves = 0;
+    uint64_t nodes = 0;
+    uint64_t depth = 0;
+    double seconds = 0;
+    std::vector<double> latencies;
+
+    // Results from this side's perspective
+    int wins = 0;
+    int draws = 0;
+    int losses = 0;
+    int time_losses = 0;
+};
+
+/**
+ * Parse side settings written as comma separated key=value pairs, such as
+ * depth=8,nodes=50000,threads=1,noise=0,hash=16
+ */
+Config parse_config(std::string name, std::string text) {
+    Config config;
+    config.name = name;
+    std::istringstream stream(text);
+    std::string pair;
+    while (std::getline(stream, pair, ',')) {
+        size_t equals = pair.find('=');
+        if (equals == std::string::npos) continue;
+        std::string key = pair.substr(0, equals);
+        std::string value = pair.substr(equals + 1);
+        if (key == "depth") {
+            config.depth = std::stoi(value);
+        } else if (key == "nodes") {
+            config.nodes = std::stoull(value);
+        } else if (key == "threads") {
+            config.threads = std::stoi(value);
+        } else if (key == "noise") {
+            config.noise = std::stoi(value);
+        } else if (key == "hash") {
+            config.table_mb = std::stoull(value);
+        } else {
+            std::cerr << "Unknown setting " << key << "\n";
+        }
+    }
+    return config;
+}
+
+/**
+ * Parse a time control written as base+increment in milliseconds
+ */
+TimeControl parse_time_control(std::string text) {
+    TimeControl control;
+    size_t plus = text.find('+');
+    control.base = std::stoll(text.substr(0, plus));
+    if (plus != std::string::npos) {
+        control.increment = std::stoll(text.substr(plus + 1));
+    }
+    return control;
+}
+
+/**
+ * Play one game between the two sides, returns 1 if the first wins, -1 if
+ * the second does and 0 for a draw
+ *
+ * Each side searches on its own engine and table for the whole game, like
+ * the bot does, and manages its clock by spending a fraction of what is left.
+ */
+int play_game(std::string fen,
+              const Config *sides[2],
+              TimeControl control,
+              Stats *stats[2],
+              bool &time_loss) {
+    brainiac::Board board(fen);
+    std::unique_ptr<TranspositionTable> tables[2];
+    std::unique_ptr<Engine> engines[2];
+    int64_t clocks[2];
+    for (int i = 0; i < 2; i++) {
+        tables[i] = std::make_unique<TranspositionTable>(
+            sides[i]->table_mb << 20,
+            false);
+        engines[i] = std::make_unique<Engine>(*tables[i]);
+        clocks[i] = control.base;
+    }
+
+    // Side 0 plays whoever is to move in the opening
+    brainiac::Color first = board.get_turn();
+    time_loss = false;
+    for (int ply = 0; ply < max_game_plies; ply++) {
+        if (board.is_checkmate()) {
+            return board.get_turn() == first ? -1 : 1;
+        }
+        if (board.is_draw()) return 0;
+
+        int side = board.get_turn() == first ? 0 : 1;
+        SearchLimits limits;
+        limits.depth = sides[side]->depth;
+        limits.nodes = sides[side]->nodes;
+        limits.threads = sides[side]->threads;
+        limits.noise = sides[side]->noise;
+        limits.time = std::chrono::milliseconds(
+            std::max<int64_t>(clocks[side] / 20 + control.increment, 1));
+
+        auto start = std::chrono::steady_clock::now();
+        SearchResult result = engines[side]->search(board, limits);
+        double seconds = std::chrono::duration<double>(
+                             std::chrono::steady_clock::now() - start)
+                             .count();
+
+        clocks[side] -= seconds * 1000;
+        if (clocks[side] < 0) {
+            time_loss = true;
+            return side == 0 ? -1 : 1;
+        }
+        clocks[side] += control.increment;
+
+        Stats &side_stats = *stats[side];
+        side_stats.moves++;
+        side_stats.nodes += result.nodes;
+        side_stats.depth += result.depth;
+        side_stats.seconds += seconds;
+        side_stats.latencies.push_back(seconds * 1000);
+        board.make_move(result.move);
+    }
+    return 0;
+}
+
+/**
+ * Get a percentile of sorted values
+ */
+double percentile(const std::vector<double> &sorted, double fraction) {
+    if (sorted.empty()) return 0;
+    size_t index = std::min<size_t>(fraction * sorted.size(),
+                                    sorted.size() - 1);
+    return sorted[index];
+}
+
+/**
+ * Elo difference implied by a score fraction
+ */
+double elo(double score) {
+    score = std::clamp(score, 1e-3, 1 - 1e-3);
+    return -400 * std::log10(1 / score - 1);
+}
+
+/**
+ * Entry function
+ *
+ * Usage: selfplay [games] [base+increment ms] [config a] [config b]
+ * [json output path]
+ *
+ * Games are played in pairs from each opening with colors swapped, on as
+ * many threads as there are cores.
+ */
+int main(int argc, char **argv) {
+    int games = argc > 1 ? std::atoi(argv[1]) : 1000;
+    TimeControl control = parse_time_control(argc > 2 ? argv[2] : "10000+100");
+    Config a = parse_config("a", argc > 3 ? argv[3] : "");
+    Config b = parse_config("b", argc > 4 ? argv[4] : "");
+    std::string output = argc > 5 ? argv[5] : "selfplay.json";
+    brainiac::init();
+
+    // Searches with helper threads take a share of the cores
+    int workers = std::thread::hardware_concurrency();
+    workers = std::max(workers / std::max(a.threads, b.threads), 1);
+
+    Stats totals[2];
+    std::mutex mutex;
+    std::atomic<int> next = 0;
+    std::atomic<int> finished = 0;
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (int i = 0; i < workers; i++) {
+        threads.emplace_back([&]() {
+            for (int game = next++; game < games; game = next++) {
+                // Pairs of games share an opening, b takes the first move in
+                // the second of the pair
+                const std::string &fen =
+                    openings[(game / 2) % openings.size()];
+                bool swapped = game % 2;
+                const Config *sides[2] = {&a, &b};
+                Stats local[2];
+                Stats *stats[2] = {&local[0], &local[1]};
+                if (swapped) {
+                    std::swap(sides[0], sides[1]);
+                    std::swap(stats[0], stats[1]);
+                }
+                bool time_loss;
+                int outcome = play_game(fen, sides, control, stats, time_loss);
+                if (swapped) outcome = -outcome;
+
+                std::lock_guard<std::mutex> lock(mutex);
+                for (int side = 0; side < 2; side++) {
+                    Stats &total = totals[side];
+                    total.moves += local[side].moves;
+                    total.nodes += local[side].nodes;
+                    total.depth += local[side].depth;
+                    total.seconds += local[side].seconds;
+                    total.latencies.insert(total.latencies.end(),
+                                           local[side].latencies.begin(),
+                                           local[side].latencies.end());
+                }
+                if (outcome > 0) {
+                    totals[0].wins++;
+                    totals[1].losses++;
+                    totals[1].time_losses += time_loss;
+                } else if (outcome < 0) {
+                    totals[0].losses++;
+                    totals[1].wins++;
+                    totals[0].time_losses += time_loss;
+                } else {
+                    totals[0].draws++;
+                    totals[1].draws++;
+                }
+                int done = ++finished;
+                if (done % 10 == 0 || done == games) {
+                    std::fprintf(stderr,
+                                 "\r%d/%d games, a +%d =%d -%d",
+                                 done,
+                                 games,
+                                 totals[0].wins,
+                                 totals[0].draws,
+                                 totals[0].losses);
+                }
+            }
+        });
+    }
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+    double elapsed = std::chrono::duration<double>(
+                         std::chrono::steady_clock::now() - start)
+                         .count();
+    std::fprintf(stderr, "\n");
+
+    // Score of a against b, with a 95% margin from the spread of results
+    int played = totals[0].wins + totals[0].draws + totals[0].losses;
+    double score = played ? (totals[0].wins + 0.5 * totals[0].draws) / played
+                          : 0.5;
+    double variance = 0;
+    if (played) {
+        variance = (totals[0].wins * std::pow(1 - score, 2) +
+                    totals[0].draws * std::pow(0.5 - score, 2) +
+                    totals[0].losses * std::pow(score, 2)) /
+                   played;
+    }
+    double margin = 1.96 * std::sqrt(variance / std::max(played, 1));
+    double difference = elo(score);
+    double error = (elo(score + margin) - elo(score - margin)) / 2;
+
+    std::printf("%d games in %.1f s on %d threads, %lld+%lld ms\n",
+                played,
+                elapsed,
+                workers,
+                static_cast<long long>(control.base),
+                static_cast<long long>(control.increment));
+    std::printf("%-4s %12s %8s %9s %9s %9s %6s %6s %6s %7s\n",
+                "side",
+                "nodes/s",
+                "depth",
+                "p50 ms",
+                "p90 ms",
+                "p99 ms",
+                "wins",
+                "draws",
+                "losses",
+                "flagged");
+    std::ofstream json(output);
+    json << "{\n  \"games\": " << played << ", \"seconds\": " << elapsed
+         << ", \"elo\": " << difference << ", \"elo_error\": " << error
+         << ",\n  \"sides\": [\n";
+    const Config *configs[2] = {&a, &b};
+    for (int side = 0; side < 2; side++) {
+        Stats &stats = totals[side];
+        std::sort(stats.latencies.begin(), stats.latencies.end());
+        double nps = stats.seconds ? stats.nodes / stats.seconds : 0;
+        double depth = stats.moves ? double(stats.depth) / stats.moves : 0;
+        double p50 = percentile(stats.latencies, 0.5);
+        double p90 = percentile(stats.latencies, 0.9);
+        double p99 = percentile(stats.latencies, 0.99);
+        std::printf("%-4s %12.0f %8.2f %9.1f %9.1f %9.1f %6d %6d %6d %7d\n",
+                    configs[side]->name.c_str(),
+                    nps,
+                    depth,
+                    p50,
+                    p90,
+                    p99,
+                    stats.wins,
+                    stats.draws,
+                    stats.losses,
+                    stats.time_losses);
+        json << "    {\"name\": \"" << configs[side]->name
+             << "\", \"nodes_per_second\": " << nps
+             << ", \"average_depth\": " << depth << ", \"p50_ms\": " << p50
+             << ", \"p90_ms\": " << p90 << ", \"p99_ms\": " << p99
+             << ", \"wins\": " << stats.wins << ", \"draws\": " << stats.draws
+             << ", \"losses\": " << stats.losses
+             << ", \"time_losses\": " << stats.time_losses << "}"
+             << (side == 0 ? ",\n" : "\n");
+    }
+    json << "  ]\n}\n";
+    std::printf("Elo of a over b: %+.1f +/- %.1f\n", difference, error);
+    std::cout << "Results written to " << output << "\n";
+    return 0;
+}
@@ -0,0 +1,19 @@
+#include "backend.h"
+
+LocalBackend::LocalBackend(EnginePool &pool, CoreBudget &cores) :
+    _pool(pool), _cores(cores) {}
+
+SearchResult LocalBackend::search(uint64_t game_id,
+                                  brainiac::Board board,
+                                  SearchLimits limits) {
+    limits.threads = _cores.acquire(limits.threads);
+    Engine &engine = _pool.checkout(game_id);
+    SearchResult result = engine.search(board, limits);
+    _pool.checkin(game_id);
+    _cores.release(limits.threads);
+    return result;
+}
+
+void LocalBackend::release(uint64_t game_id) {
+    _pool.release(game_id);
+}
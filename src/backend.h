@@ -0,0 +1,56 @@
+#ifndef BACKEND_H_
+#define BACKEND_H_
+
+#include <brainiac.h>
+#include <cstdint>
+
+#include "engine.h"
+#include "pool.h"
+#include "service.h"
+
+/**
+ * Source of bot moves
+ *
+ * Searches are called from the search workers and may block until done.
+ */
+class EngineBackend {
+  public:
+    virtual ~EngineBackend() = default;
+
+    /**
+     * Search a position of a game for the best move
+     *
+     * Returns an invalid move if the backend failed to search.
+     */
+    virtual SearchResult search(uint64_t game_id,
+                                brainiac::Board board,
+                                SearchLimits limits) = 0;
+
+    /**
+     * Drop any state kept for a game that is over
+     */
+    virtual void release(uint64_t game_id) = 0;
+};
+
+/**
+ * Backend searching inside the bot process on the game's pooled engine
+ */
+class LocalBackend : public EngineBackend {
+    EnginePool &_pool;
+    CoreBudget &_cores;
+
+  public:
+    LocalBackend(EnginePool &pool, CoreBudget &cores);
+
+    /**
+     * Search on the game's engine, with as many of the requested threads as
+     * the core budget allows
+     */
+    SearchResult search(uint64_t game_id,
+                        brainiac::Board board,
+                        SearchLimits limits) override;
+
+    void release(uint64_t game_id) override;
+};
+
+#endif
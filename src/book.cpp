@@ -0,0 +1,198 @@
+#include "book.h"
+
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+#include "engine.h"
+
+/**
+ * Size of a book entry: key, move, weight and learn data, all big-endian
+ */
+constexpr size_t entry_size = 16;
+
+/**
+ * Key of the starting position, as given by the Polyglot specification
+ */
+constexpr uint64_t start_key = 0x463b96181691fc9cULL;
+
+/**
+ * Read a big-endian number from a book entry
+ */
+uint64_t read_big_endian(const uint8_t *bytes, int length) {
+    uint64_t value = 0;
+    for (int i = 0; i < length; i++) {
+        value = (value << 8) | bytes[i];
+    }
+    return value;
+}
+
+OpeningBook::OpeningBook(std::string path, std::string randoms_path) {
+    if (!load_randoms(randoms_path)) return;
+
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) return;
+    struct stat info;
+    if (fstat(fd, &info) == 0 && size_t(info.st_size) >= entry_size) {
+        void *memory =
+            mmap(nullptr, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (memory != MAP_FAILED) {
+            _entries = static_cast<const uint8_t *>(memory);
+            _bytes = info.st_size;
+            _count = _bytes / entry_size;
+        }
+    }
+
+    // The mapping outlives the descriptor
+    close(fd);
+}
+
+OpeningBook::~OpeningBook() {
+    if (_entries) {
+        munmap(const_cast<uint8_t *>(_entries), _bytes);
+    }
+}
+
+bool OpeningBook::load_randoms(std::string path) {
+    std::ifstream file(path);
+    for (int i = 0; i < polyglot_randoms; i++) {
+        if (!(file >> std::hex >> _random[i])) {
+            std::cout << "Opening book: could not read the random values in "
+                      << path << "\n";
+            return false;
+        }
+    }
+
+    // Wrong values would silently miss every position
+    brainiac::Board start;
+    if (key(start) != start_key) {
+        std::cout << "Opening book: random values in " << path
+                  << " do not give the starting position's key\n";
+        return false;
+    }
+    return true;
+}
+
+uint64_t OpeningBook::key(brainiac::Board &board) {
+    uint64_t key = 0;
+
+    // Pieces are ordered black pawn, white pawn, black knight and so on
+    for (int rank = 0; rank < 8; rank++) {
+        for (int file = 0; file < 8; file++) {
+            brainiac::Piece piece = board.get_at_coords(rank, file);
+            if (piece.is_empty()) continue;
+            int kind = 2 * type_index(piece.get_type()) +
+                       (piece.get_color() == brainiac::Color::White);
+            key ^= _random[64 * kind + 8 * rank + file];
+        }
+    }
+
+    // Castling rights and en passant square are read from the FEN
+    std::istringstream fen(board.generate_fen());
+    std::string placement, turn, castling, en_passant;
+    fen >> placement >> turn >> castling >> en_passant;
+    const std::string rights = "KQkq";
+    for (int i = 0; i < 4; i++) {
+        if (castling.find(rights[i]) != std::string::npos) {
+            key ^= _random[768 + i];
+        }
+    }
+
+    // En passant only counts if a pawn can actually capture
+    if (en_passant.size() == 2) {
+        int file = en_passant[0] - 'a';
+        bool white = board.get_turn() == brainiac::Color::White;
+        int rank = white ? 4 : 3;
+        for (int side : {file - 1, file + 1}) {
+            if (side < 0 || side > 7) continue;
+            brainiac::Piece piece = board.get_at_coords(rank, side);
+            if (!piece.is_empty() &&
+                piece.get_type() == brainiac::PieceType::Pawn &&
+                (piece.get_color() == brainiac::Color::White) == white) {
+                key ^= _random[772 + file];
+                break;
+            }
+        }
+    }
+
+    if (board.get_turn() == brainiac::Color::White) {
+        key ^= _random[780];
+    }
+    return key;
+}
+
+brainiac::Move OpeningBook::probe(brainiac::Board &board) {
+    if (!_count) return brainiac::Move();
+    uint64_t position = key(board);
+
+    // Find the first entry of the position
+    size_t low = 0;
+    size_t high = _count;
+    while (low < high) {
+        size_t middle = (low + high) / 2;
+        if (read_big_endian(_entries + middle * entry_size, 8) < position) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+
+    std::vector<std::pair<uint16_t, uint16_t>> moves;
+    uint32_t total = 0;
+    for (size_t i = low; i < _count; i++) {
+        const uint8_t *entry = _entries + i * entry_size;
+        if (read_big_endian(entry, 8) != position) break;
+        uint16_t move = read_big_endian(entry + 8, 2);
+        uint16_t weight = read_big_endian(entry + 10, 2);
+        moves.emplace_back(move, weight);
+        total += weight;
+    }
+    if (moves.empty()) return brainiac::Move();
+
+    // Pick by weight, or uniformly if every weight is zero
+    thread_local std::mt19937 random(std::random_device{}());
+    size_t choice = 0;
+    if (total) {
+        uint32_t target = std::uniform_int_distribution<uint32_t>(
+            0, total - 1)(random);
+        while (target >= moves[choice].second) {
+            target -= moves[choice].second;
+            choice++;
+        }
+    } else {
+        choice = std::uniform_int_distribution<size_t>(
+            0, moves.size() - 1)(random);
+    }
+
+    // Moves pack the destination file and rank, then the origin, then the
+    // promotion piece
+    uint16_t move = moves[choice].first;
+    int to_file = move & 7;
+    int to_rank = (move >> 3) & 7;
+    int from_file = (move >> 6) & 7;
+    int from_rank = (move >> 9) & 7;
+    int promotion = (move >> 12) & 7;
+
+    // Castling is written as the king capturing its own rook
+    brainiac::Piece piece = board.get_at_coords(from_rank, from_file);
+    if (!piece.is_empty() && piece.get_type() == brainiac::PieceType::King &&
+        from_file == 4 && (to_file == 0 || to_file == 7)) {
+        to_file = to_file == 7 ? 6 : 2;
+    }
+
+    char promotions[] = {0, 'n', 'b', 'r', 'q'};
+    return board.create_move(
+        static_cast<brainiac::Square>(from_rank * 8 + from_file),
+        static_cast<brainiac::Square>(to_rank * 8 + to_file),
+        promotion < 5 ? promotions[promotion] : 0);
+}
+
+size_t OpeningBook::size() {
+    return _count;
+}
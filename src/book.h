@@ -0,0 +1,64 @@
+#ifndef BOOK_H_
+#define BOOK_H_
+
+#include <brainiac.h>
+#include <cstdint>
+#include <string>
+
+/**
+ * Number of random values making up Polyglot position keys
+ */
+constexpr int polyglot_randoms = 781;
+
+/**
+ * Polyglot opening book
+ *
+ * The book file is memory-mapped read-only and its entries, sorted by
+ * position key, are binary searched. Keys are computed with the standard
+ * Polyglot random values, which are read from a separate text file of 781
+ * hexadecimal numbers and checked against the known key of the starting
+ * position.
+ */
+class OpeningBook {
+    const uint8_t *_entries = nullptr;
+    size_t _count = 0;
+    size_t _bytes = 0;
+
+    uint64_t _random[polyglot_randoms];
+
+    /**
+     * Read the random values, returns true if they are the standard ones
+     */
+    bool load_randoms(std::string path);
+
+  public:
+    /**
+     * Open a book file with the path of its random values
+     *
+     * The book stays empty if either file is missing or invalid.
+     */
+    OpeningBook(std::string path, std::string randoms_path);
+    ~OpeningBook();
+
+    OpeningBook(const OpeningBook &) = delete;
+    OpeningBook &operator=(const OpeningBook &) = delete;
+
+    /**
+     * Get the Polyglot key of a position
+     */
+    uint64_t key(brainiac::Board &board);
+
+    /**
+     * Pick a book move for a position, weighted by how often it is played
+     *
+     * Returns an invalid move if the position is not in the book.
+     */
+    brainiac::Move probe(brainiac::Board &board);
+
+    /**
+     * Get the number of entries in the book
+     */
+    size_t size();
+};
+
+#endif
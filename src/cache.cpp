@@ -0,0 +1,29 @@
+#include "cache.h"
+
+SearchCache::SearchCache(size_t capacity) : _capacity(capacity) {}
+
+bool SearchCache::find(uint64_t key, SearchResult &result) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto it = _entries.find(key);
+    if (it == _entries.end()) return false;
+    _used.splice(_used.begin(), _used, it->second.used);
+    result = it->second.result;
+    return true;
+}
+
+void SearchCache::store(uint64_t key, const SearchResult &result) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_capacity == 0) return;
+    auto it = _entries.find(key);
+    if (it != _entries.end()) {
+        _used.splice(_used.begin(), _used, it->second.used);
+        it->second.result = result;
+        return;
+    }
+    if (_entries.size() >= _capacity) {
+        _entries.erase(_used.back());
+        _used.pop_back();
+    }
+    _used.push_front(key);
+    _entries[key] = {result, _used.begin()};
+}
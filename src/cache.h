@@ -0,0 +1,48 @@
+#ifndef CACHE_H_
+#define CACHE_H_
+
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+#include "engine.h"
+
+/**
+ * Finished search results by position, for searches users repeat
+ *
+ * Holds a fixed number of results and drops the least recently used first.
+ * Keys are the hash of the position mixed with whatever else sets the search
+ * apart, such as the number of lines.
+ */
+class SearchCache {
+    struct Entry {
+        SearchResult result;
+
+        // Position in the recency list
+        std::list<uint64_t>::iterator used;
+    };
+
+    std::unordered_map<uint64_t, Entry> _entries;
+
+    // Keys from most to least recently used
+    std::list<uint64_t> _used;
+
+    size_t _capacity;
+    std::mutex _mutex;
+
+  public:
+    SearchCache(size_t capacity);
+
+    /**
+     * Look up the result stored for a key, returns false if there is none
+     */
+    bool find(uint64_t key, SearchResult &result);
+
+    /**
+     * Store the result of a search, replacing any stored for the key
+     */
+    void store(uint64_t key, const SearchResult &result);
+};
+
+#endif
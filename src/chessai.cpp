@@ -1,8 +1,11 @@
+#include <algorithm>
 #include <brainiac.h>
 #include <dpp/dpp.h>
 #include <fstream>
 #include <iostream>
 #include <memory>
+#include <sstream>
+#include <thread>
 #include <unordered_map>
 
 #include "server.h"
@@ -43,10 +46,123 @@ std::string env_get(std::string const &key) {
  */
 int main() {
     std::string token = env_get("API_KEY");
-    dpp::cluster bot(token);
-    ChessServer server(bot);
     brainiac::init();
 
+    ServerConfig config;
+    config.search_workers = std::thread::hardware_concurrency();
+    std::string search_workers = env_get("SEARCH_WORKERS");
+    if (search_workers.size()) {
+        config.search_workers = std::stoi(search_workers);
+    }
+    config.scheduler.guild_limit = std::max(config.search_workers / 2, 1);
+    config.scheduler.user_limit = 2;
+    config.scheduler.queue_slo = std::chrono::milliseconds(2000);
+    std::string guild_limit = env_get("GUILD_SEARCHES");
+    if (guild_limit.size()) {
+        config.scheduler.guild_limit = std::stoi(guild_limit);
+    }
+    std::string user_limit = env_get("USER_SEARCHES");
+    if (user_limit.size()) {
+        config.scheduler.user_limit = std::stoi(user_limit);
+    }
+    std::string queue_slo = env_get("QUEUE_SLO_MS");
+    if (queue_slo.size()) {
+        config.scheduler.queue_slo =
+            std::chrono::milliseconds(std::stoll(queue_slo));
+    }
+
+    // Weights are given as guild:weight pairs separated by commas
+    std::stringstream guild_weights(env_get("GUILD_WEIGHTS"));
+    std::string guild_weight;
+    while (std::getline(guild_weights, guild_weight, ',')) {
+        size_t colon = guild_weight.find(':');
+        if (colon == std::string::npos) continue;
+        config.scheduler.weights[std::stoull(guild_weight.substr(0, colon))] =
+            std::stoi(guild_weight.substr(colon + 1));
+    }
+    std::string engine_memory = env_get("ENGINE_MEMORY_MB");
+    if (engine_memory.size()) {
+        config.engine_memory = std::stoull(engine_memory) << 20;
+    }
+    std::string table_size = env_get("TABLE_SIZE_MB");
+    if (table_size.size()) {
+        config.table_size = std::stoull(table_size) << 20;
+    }
+    config.huge_pages = env_get("HUGE_PAGES") != "0";
+    std::string book_path = env_get("BOOK_PATH");
+    if (book_path.size()) {
+        config.book_path = book_path;
+    }
+    std::string book_randoms = env_get("BOOK_RANDOMS");
+    if (book_randoms.size()) {
+        config.book_randoms = book_randoms;
+    }
+    config.syzygy_path = env_get("SYZYGY_PATH");
+    std::string syzygy_pieces = env_get("SYZYGY_PIECES");
+    if (syzygy_pieces.size()) {
+        config.syzygy_pieces = std::stoi(syzygy_pieces);
+    }
+    config.engine_command = env_get("ENGINE_COMMAND");
+    config.engine_processes = config.search_workers;
+    std::string engine_processes = env_get("ENGINE_PROCESSES");
+    if (engine_processes.size()) {
+        config.engine_processes = std::stoi(engine_processes);
+    }
+    std::string simul_budget = env_get("SIMUL_BUDGET_MS");
+    if (simul_budget.size()) {
+        config.simul_budget =
+            std::chrono::milliseconds(std::stoll(simul_budget));
+    }
+    std::string search_depth = env_get("SEARCH_DEPTH");
+    if (search_depth.size()) {
+        config.search_depth = std::stoi(search_depth);
+    }
+    std::string search_nodes = env_get("SEARCH_NODES");
+    if (search_nodes.size()) {
+        config.search_nodes = std::stoull(search_nodes);
+    }
+    std::string search_time = env_get("SEARCH_TIME_MS");
+    if (search_time.size()) {
+        config.search_time = std::chrono::milliseconds(std::stoll(search_time));
+    }
+    config.cores = std::thread::hardware_concurrency();
+    std::string cores = env_get("CORES");
+    if (cores.size()) {
+        config.cores = std::stoi(cores);
+    }
+    std::string search_threads = env_get("SEARCH_THREADS");
+    if (search_threads.size()) {
+        config.search_threads = std::stoi(search_threads);
+    }
+    std::string max_ponders = env_get("MAX_PONDERS");
+    if (max_ponders.size()) {
+        config.max_ponders = std::stoi(max_ponders);
+        config.ponder = config.max_ponders > 0;
+    }
+
+    std::string analysis_time = env_get("ANALYSIS_TIME_MS");
+    if (analysis_time.size()) {
+        config.analysis_time =
+            std::chrono::milliseconds(std::stoll(analysis_time));
+    }
+
+    std::string hint_depth = env_get("HINT_DEPTH");
+    if (hint_depth.size()) {
+        config.hint_depth = std::stoi(hint_depth);
+    }
+    std::string hint_nodes = env_get("HINT_NODES");
+    if (hint_nodes.size()) {
+        config.hint_nodes = std::stoull(hint_nodes);
+    }
+
+    std::string board_canvases = env_get("BOARD_CANVASES");
+    if (board_canvases.size()) {
+        config.board_canvases = std::stoull(board_canvases);
+    }
+
+    dpp::cluster bot(token);
+    ChessServer server(bot, config);
+
     bot.on_log(dpp::utility::cout_logger());
 
     bot.on_ready([&bot, &server](const dpp::ready_t &event) {
@@ -66,13 +182,31 @@ int main() {
                                             false)
                             .add_choice(dpp::command_option_choice("w", "w"))
                             .add_choice(dpp::command_option_choice("b", "b")));
+        play.add_option(dpp::command_option(dpp::co_integer,
+                                            "level",
+                                            "Strength of the bot, 1 to 8",
+                                            false)
+                            .set_min_value(1)
+                            .set_max_value(max_level));
         bot.global_command_create(play);
 
+        dpp::slashcommand simul("simul",
+                                "Join the bot's simul in this channel",
+                                bot.me.id);
+        simul.add_option(dpp::command_option(dpp::co_integer,
+                                             "level",
+                                             "Strength of the bot, 1 to 8",
+                                             false)
+                             .set_min_value(1)
+                             .set_max_value(max_level));
+        bot.global_command_create(simul);
+
         dpp::slashcommand move("move", "Execute a move in a match", bot.me.id);
         move.add_option(dpp::command_option(dpp::co_string,
                                             "move",
-                                            "Standard notation move string",
-                                            true));
+                                            "Move such as Nf3, e8=Q or g1f3",
+                                            true)
+                            .set_auto_complete(true));
         bot.global_command_create(move);
 
         dpp::slashcommand board("board",
@@ -80,6 +214,35 @@ int main() {
                                 bot.me.id);
         bot.global_command_create(board);
 
+        dpp::slashcommand display("display",
+                                  "Choose how boards are displayed",
+                                  bot.me.id);
+        display.add_option(
+            dpp::command_option(dpp::co_string,
+                                "mode",
+                                "Image, or text for restricted channels",
+                                true)
+                .add_choice(dpp::command_option_choice("image", "image"))
+                .add_choice(dpp::command_option_choice("unicode", "unicode"))
+                .add_choice(dpp::command_option_choice("ascii", "ascii")));
+        bot.global_command_create(display);
+
+        dpp::slashcommand analyze("analyze",
+                                  "Show the best lines in your match",
+                                  bot.me.id);
+        analyze.add_option(dpp::command_option(dpp::co_integer,
+                                               "lines",
+                                               "Number of lines, 1 to 5",
+                                               false)
+                               .set_min_value(1)
+                               .set_max_value(5));
+        bot.global_command_create(analyze);
+
+        dpp::slashcommand hint("hint",
+                               "Suggest a move for your turn",
+                               bot.me.id);
+        bot.global_command_create(hint);
+
         dpp::slashcommand resign("resign",
                                  "Resign from the current match",
                                  bot.me.id);
@@ -0,0 +1,577 @@
+#include "engine.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <thread>
+
+/**
+ * Material value of each piece type in centipawns
+ */
+constexpr int piece_values[6] = {100, 320, 330, 500, 900, 0};
+
+/**
+ * Positional bonus of each piece type by square, from White's side with the
+ * eighth rank first
+ */
+constexpr int piece_squares[6][64] = {
+    // Pawn
+    {
+          0,   0,   0,   0,   0,   0,   0,   0,
+         50,  50,  50,  50,  50,  50,  50,  50,
+         10,  10,  20,  30,  30,  20,  10,  10,
+          5,   5,  10,  25,  25,  10,   5,   5,
+          0,   0,   0,  20,  20,   0,   0,   0,
+          5,  -5, -10,   0,   0, -10,  -5,   5,
+          5,  10,  10, -20, -20,  10,  10,   5,
+          0,   0,   0,   0,   0,   0,   0,   0,
+    },
+    // Knight
+    {
+        -50, -40, -30, -30, -30, -30, -40, -50,
+        -40, -20,   0,   0,   0,   0, -20, -40,
+        -30,   0,  10,  15,  15,  10,   0, -30,
+        -30,   5,  15,  20,  20,  15,   5, -30,
+        -30,   0,  15,  20,  20,  15,   0, -30,
+        -30,   5,  10,  15,  15,  10,   5, -30,
+        -40, -20,   0,   5,   5,   0, -20, -40,
+        -50, -40, -30, -30, -30, -30, -40, -50,
+    },
+    // Bishop
+    {
+        -20, -10, -10, -10, -10, -10, -10, -20,
+        -10,   0,   0,   0,   0,   0,   0, -10,
+        -10,   0,   5,  10,  10,   5,   0, -10,
+        -10,   5,   5,  10,  10,   5,   5, -10,
+        -10,   0,  10,  10,  10,  10,   0, -10,
+        -10,  10,  10,  10,  10,  10,  10, -10,
+        -10,   5,   0,   0,   0,   0,   5, -10,
+        -20, -10, -10, -10, -10, -10, -10, -20,
+    },
+    // Rook
+    {
+          0,   0,   0,   0,   0,   0,   0,   0,
+          5,  10,  10,  10,  10,  10,  10,   5,
+         -5,   0,   0,   0,   0,   0,   0,  -5,
+         -5,   0,   0,   0,   0,   0,   0,  -5,
+         -5,   0,   0,   0,   0,   0,   0,  -5,
+         -5,   0,   0,   0,   0,   0,   0,  -5,
+         -5,   0,   0,   0,   0,   0,   0,  -5,
+          0,   0,   0,   5,   5,   0,   0,   0,
+    },
+    // Queen
+    {
+        -20, -10, -10,  -5,  -5, -10, -10, -20,
+        -10,   0,   0,   0,   0,   0,   0, -10,
+        -10,   0,   5,   5,   5,   5,   0, -10,
+         -5,   0,   5,   5,   5,   5,   0,  -5,
+          0,   0,   5,   5,   5,   5,   0,  -5,
+        -10,   5,   5,   5,   5,   5,   0, -10,
+        -10,   0,   5,   0,   0,   0,   0, -10,
+        -20, -10, -10,  -5,  -5, -10, -10, -20,
+    },
+    // King
+    {
+        -30, -40, -40, -50, -50, -40, -40, -30,
+        -30, -40, -40, -50, -50, -40, -40, -30,
+        -30, -40, -40, -50, -50, -40, -40, -30,
+        -30, -40, -40, -50, -50, -40, -40, -30,
+        -20, -30, -30, -40, -40, -30, -30, -20,
+        -10, -20, -20, -20, -20, -20, -20, -10,
+         20,  20,   0,   0,   0,   0,  20,  20,
+         20,  30,  10,   0,   0,  10,  30,  20,
+    },
+};
+
+int type_index(brainiac::PieceType type) {
+    switch (type) {
+    case brainiac::PieceType::Pawn:
+        return 0;
+    case brainiac::PieceType::Knight:
+        return 1;
+    case brainiac::PieceType::Bishop:
+        return 2;
+    case brainiac::PieceType::Rook:
+        return 3;
+    case brainiac::PieceType::Queen:
+        return 4;
+    default:
+        return 5;
+    }
+}
+
+/**
+ * Compact form of a move stored in the transposition table
+ */
+uint16_t move_key(brainiac::Move move) {
+    return move.get_from() | (move.get_to() << 6);
+}
+
+/**
+ * Get the piece on a square
+ */
+brainiac::Piece piece_at(brainiac::Board &board, int square) {
+    return board.get_at_coords(square / 8, square % 8);
+}
+
+/**
+ * Mate scores are stored relative to the node rather than the root
+ */
+int to_table(int score, int ply) {
+    if (score > mate_score - max_ply) return score + ply;
+    if (score < -mate_score + max_ply) return score - ply;
+    return score;
+}
+
+int from_table(int score, int ply) {
+    if (score > mate_score - max_ply) return score - ply;
+    if (score < -mate_score + max_ply) return score + ply;
+    return score;
+}
+
+int evaluate(brainiac::Board &board) {
+    int score = 0;
+    for (int rank = 0; rank < 8; rank++) {
+        for (int file = 0; file < 8; file++) {
+            brainiac::Piece piece = board.get_at_coords(rank, file);
+            if (piece.is_empty()) continue;
+
+            int type = type_index(piece.get_type());
+            if (piece.get_color() == brainiac::Color::White) {
+                score += piece_values[type] +
+                         piece_squares[type][(7 - rank) * 8 + file];
+            } else {
+                score -= piece_values[type] +
+                         piece_squares[type][rank * 8 + file];
+            }
+        }
+    }
+    return board.get_turn() == brainiac::Color::White ? score : -score;
+}
+
+bool same_move(brainiac::Move a, brainiac::Move b) {
+    return a.get_from() == b.get_from() && a.get_to() == b.get_to() &&
+           a.standard_notation() == b.standard_notation();
+}
+
+/**
+ * Estimate of the memory of a hash map, counting its nodes and buckets
+ */
+template <typename Map>
+size_t map_memory(const Map &map) {
+    return map.size() *
+               (sizeof(typename Map::value_type) + 2 * sizeof(void *)) +
+           map.bucket_count() * sizeof(void *);
+}
+
+void SearchThread::warm_start(brainiac::Board &board) {
+    auto it = std::find(_line.begin(), _line.end(), board.get_hash());
+    if (it == _line.end()) {
+        for (int ply = 0; ply < max_ply; ply++) {
+            _killers[ply][0] = brainiac::Move();
+            _killers[ply][1] = brainiac::Move();
+        }
+        _expected.clear();
+        _played = 0;
+        return;
+    }
+
+    // Killers of the last search apply as many plies closer to the root as
+    // have been played since
+    int played = it - _line.begin() + 1;
+    _played = played;
+    for (int ply = 0; ply < max_ply; ply++) {
+        if (ply + played < max_ply) {
+            _killers[ply][0] = _killers[ply + played][0];
+            _killers[ply][1] = _killers[ply + played][1];
+        } else {
+            _killers[ply][0] = brainiac::Move();
+            _killers[ply][1] = brainiac::Move();
+        }
+    }
+}
+
+bool SearchThread::excluded(brainiac::Move move) {
+    for (brainiac::Move &other : _excluded) {
+        if (same_move(move, other)) return true;
+    }
+    return false;
+}
+
+SearchThread::SearchThread(TranspositionTable &table, Tablebase *tablebase) :
+    _table(table), _tablebase(tablebase), _random(std::random_device()()) {
+    std::memset(_history, 0, sizeof(_history));
+}
+
+bool SearchThread::should_stop() {
+    if ((_nodes & 1023) == 0) {
+        if ((_stop && _stop->load(std::memory_order_relaxed)) ||
+            (_yield && _yield->load(std::memory_order_relaxed)) ||
+            (_max_nodes && _nodes >= _max_nodes) ||
+            (_timed && std::chrono::steady_clock::now() >= _deadline)) {
+            _stopped = true;
+        }
+    }
+    return _stopped;
+}
+
+void SearchThread::order_moves(brainiac::Board &board,
+                               std::vector<brainiac::Move> &moves,
+                               uint16_t table_move,
+                               int ply) {
+    std::vector<std::pair<int, int>> scores;
+    for (int i = 0; i < moves.size(); i++) {
+        brainiac::Move &move = moves[i];
+        brainiac::Piece victim = piece_at(board, move.get_to());
+        int score = _history[move.get_from()][move.get_to()];
+        if (move_key(move) == table_move) {
+            score = 1 << 30;
+        } else if (!victim.is_empty()) {
+            // Most valuable victim, least valuable attacker
+            brainiac::Piece attacker = piece_at(board, move.get_from());
+            score = (1 << 28) +
+                    16 * piece_values[type_index(victim.get_type())] -
+                    type_index(attacker.get_type());
+        } else if (same_move(move, _killers[ply][0]) ||
+                   same_move(move, _killers[ply][1])) {
+            score = 1 << 27;
+        }
+        scores.emplace_back(score, i);
+    }
+    std::stable_sort(scores.begin(),
+                     scores.end(),
+                     [](auto &a, auto &b) { return a.first > b.first; });
+
+    std::vector<brainiac::Move> ordered;
+    ordered.reserve(moves.size());
+    for (auto &score : scores) {
+        ordered.push_back(moves[score.second]);
+    }
+    moves = std::move(ordered);
+}
+
+int SearchThread::quiescence(brainiac::Board &board,
+                             int alpha,
+                             int beta,
+                             int ply) {
+    _nodes++;
+    _pv_length[ply] = ply;
+    if (should_stop()) return 0;
+
+    int stand_pat = evaluate(board);
+    if (stand_pat >= beta || ply >= max_ply - 1) return stand_pat;
+    alpha = std::max(alpha, stand_pat);
+
+    std::vector<brainiac::Move> moves = board.get_moves();
+    if (moves.empty()) {
+        return board.is_check() ? -mate_score + ply : 0;
+    }
+
+    // Only captures are searched
+    std::vector<brainiac::Move> captures;
+    for (brainiac::Move &move : moves) {
+        if (!piece_at(board, move.get_to()).is_empty()) {
+            captures.push_back(move);
+        }
+    }
+    order_moves(board, captures, 0, ply);
+
+    for (brainiac::Move &move : captures) {
+        board.make_move(move);
+        int score = -quiescence(board, -beta, -alpha, ply + 1);
+        board.undo_move();
+        if (_stopped) return 0;
+        if (score >= beta) return score;
+        alpha = std::max(alpha, score);
+    }
+    return alpha;
+}
+
+int SearchThread::negamax(brainiac::Board &board,
+                          int depth,
+                          int alpha,
+                          int beta,
+                          int ply) {
+    _pv_length[ply] = ply;
+    if (ply > 0 && board.is_draw()) return 0;
+    if (depth <= 0 || ply >= max_ply - 1) {
+        return quiescence(board, alpha, beta, ply);
+    }
+    _nodes++;
+    if (should_stop()) return 0;
+
+    // Probe the transposition table for a cutoff or a move to try first
+    uint64_t key = board.get_hash();
+    TableEntry entry;
+    uint16_t expected = 0;
+    if (_on_line[ply] && _played + ply < _expected.size()) {
+        expected = _expected[_played + ply];
+    }
+    uint16_t table_move = expected;
+    if (_table.probe(key, entry)) {
+        table_move = entry.move;
+        // Cutoffs are only taken off the principal variation, so the full
+        // line is still known after a search that starts warm
+        if (beta - alpha == 1 && entry.depth >= depth) {
+            int score = from_table(entry.score, ply);
+            if (entry.bound == Bound::Exact ||
+                (entry.bound == Bound::Lower && score >= beta) ||
+                (entry.bound == Bound::Upper && score <= alpha)) {
+                return score;
+            }
+        }
+    }
+
+    std::vector<brainiac::Move> moves = board.get_moves();
+    if (moves.empty()) {
+        return board.is_check() ? -mate_score + ply : 0;
+    }
+    order_moves(board, moves, table_move, ply);
+
+    int original_alpha = alpha;
+    int best_score = -mate_score;
+    brainiac::Move best_move = moves[0];
+    int searched = 0;
+    for (brainiac::Move &move : moves) {
+        if (ply == 0 && excluded(move)) continue;
+        bool capture = !piece_at(board, move.get_to()).is_empty();
+
+        // Root moves may carry noise, the window shifts by it so the noisy
+        // score is still searched exactly
+        int bias = 0;
+        if (ply == 0 && _noise.size()) {
+            bias = _noise[move_key(move)];
+        }
+        int low = alpha - bias;
+        int high = beta - bias;
+
+        // Search the first move with a full window, and the rest with a null
+        // window that is widened only if they turn out better
+        board.make_move(move);
+        _on_line[ply + 1] = expected && move_key(move) == expected;
+        int score;
+        int outcome;
+        if (capture && _tablebase && _tablebase->probe_wdl(board, outcome)) {
+            // Captures into the tablebases need no search
+            score = -outcome * (tablebase_win - ply - 1) + bias;
+            _pv_length[ply + 1] = ply + 1;
+        } else if (searched == 0) {
+            score = -negamax(board, depth - 1, -high, -low, ply + 1) + bias;
+        } else {
+            score = -negamax(board, depth - 1, -low - 1, -low, ply + 1) + bias;
+            if (score > alpha && score < beta) {
+                score = -negamax(board, depth - 1, -high, -low, ply + 1) + bias;
+            }
+        }
+        board.undo_move();
+        if (_stopped) return 0;
+        searched++;
+
+        // Noise may not push a lost move below the starting window, or a
+        // root where every move is mated would be left without a line
+        if (bias) score = std::max(score, -mate_score + 1);
+
+        if (score > best_score) {
+            best_score = score;
+            best_move = move;
+        }
+        if (score > alpha) {
+            alpha = score;
+            _pv[ply][ply] = move;
+            for (int j = ply + 1; j < _pv_length[ply + 1]; j++) {
+                _pv[ply][j] = _pv[ply + 1][j];
+            }
+            _pv_length[ply] = _pv_length[ply + 1];
+        }
+        if (alpha >= beta) {
+            if (!capture) {
+                if (!same_move(move, _killers[ply][0])) {
+                    _killers[ply][1] = _killers[ply][0];
+                    _killers[ply][0] = move;
+                }
+                _history[move.get_from()][move.get_to()] += depth * depth;
+            }
+            break;
+        }
+    }
+
+    // Noisy root scores and those missing excluded moves would mislead
+    // other searches of the position
+    if (ply == 0 && (_noise.size() || _excluded.size())) return best_score;
+
+    entry.score = to_table(best_score, ply);
+    entry.move = move_key(best_move);
+    entry.depth = depth;
+    if (best_score <= original_alpha) {
+        entry.bound = Bound::Upper;
+    } else if (best_score >= beta) {
+        entry.bound = Bound::Lower;
+    } else {
+        entry.bound = Bound::Exact;
+    }
+    _table.store(key, entry);
+    return best_score;
+}
+
+SearchResult SearchThread::search(brainiac::Board board,
+                                  int first_depth,
+                                  const SearchLimits &limits) {
+    auto start = std::chrono::steady_clock::now();
+    _nodes = 0;
+    _max_nodes = limits.nodes;
+    _deadline = start + limits.time;
+    _timed = limits.time.count() > 0;
+    _stop = limits.stop;
+    _yield = limits.yield;
+    _stopped = false;
+
+    // Killers are tied to plies of the last search, history only fades
+    warm_start(board);
+    _on_line[0] = true;
+    for (auto &row : _history) {
+        for (int &score : row) {
+            score /= 2;
+        }
+    }
+
+    SearchResult result;
+    std::vector<brainiac::Move> moves = board.get_moves();
+    if (moves.empty()) return result;
+    result.move = moves[0];
+
+    _noise.clear();
+    if (limits.noise > 0) {
+        std::uniform_int_distribution<int> noise(-limits.noise, limits.noise);
+        for (brainiac::Move &move : moves) {
+            _noise[move_key(move)] = noise(_random);
+        }
+    }
+
+    int line_count = std::min<int>(std::max(limits.lines, 1), moves.size());
+    for (int depth = first_depth; depth <= limits.depth; depth++) {
+        // Each line is searched with the first moves of the better ones
+        // excluded from the root
+        std::vector<SearchLine> lines;
+        _excluded.clear();
+        while (lines.size() < line_count) {
+            int score = negamax(board, depth, -mate_score, mate_score, 0);
+            if (_stopped || _pv_length[0] == 0) break;
+            lines.push_back({score, {_pv[0], _pv[0] + _pv_length[0]}});
+            _excluded.push_back(_pv[0][0]);
+        }
+        _excluded.clear();
+        if (_stopped || lines.empty()) break;
+
+        // Only completed iterations are trusted
+        std::stable_sort(lines.begin(),
+                         lines.end(),
+                         [](auto &a, auto &b) { return a.score > b.score; });
+        result.score = lines[0].score;
+        result.depth = depth;
+        result.pv = lines[0].pv;
+        result.move = result.pv[0];
+        result.lines = std::move(lines);
+        if (limits.progress) {
+            result.nodes = _nodes;
+            result.seconds = std::chrono::duration<double>(
+                                 std::chrono::steady_clock::now() - start)
+                                 .count();
+            limits.progress(result);
+        }
+
+        // No need to look further once a forced mate is found
+        int score = result.score;
+        if (std::abs(score) > mate_score - max_ply) break;
+        if (_timed &&
+            std::chrono::steady_clock::now() - start > limits.time / 2) {
+            break;
+        }
+    }
+    result.nodes = _nodes;
+
+    // Remember the expected line for the next search of the game
+    _expected.clear();
+    _line.clear();
+    _played = 0;
+    for (brainiac::Move &move : result.pv) {
+        _expected.push_back(move_key(move));
+        board.make_move(move);
+        _line.push_back(board.get_hash());
+    }
+    return result;
+}
+
+Engine::Engine(TranspositionTable &table, Tablebase *tablebase) :
+    _table(table), _tablebase(tablebase) {}
+
+SearchResult Engine::search(brainiac::Board board, SearchLimits limits) {
+    auto start = std::chrono::steady_clock::now();
+
+    // Positions in the tablebases are already solved
+    int outcome;
+    brainiac::Move solved;
+    if (_tablebase) {
+        solved = _tablebase->probe_root(board, outcome);
+    }
+    if (!solved.is_invalid()) {
+        SearchResult result;
+        result.move = solved;
+        result.score = outcome * tablebase_win;
+        result.seconds = std::chrono::duration<double>(
+                             std::chrono::steady_clock::now() - start)
+                             .count();
+        return result;
+    }
+
+    _table.new_search();
+    int threads = std::max(limits.threads, 1);
+    while (_threads.size() < threads) {
+        _threads.push_back(
+            std::make_unique<SearchThread>(_table, _tablebase));
+    }
+
+    // Helpers start at staggered depths so they do not all search the same
+    // tree in lockstep, and stop once the main thread is done
+    std::atomic<bool> done = false;
+    SearchLimits helper_limits = limits;
+    helper_limits.stop = &done;
+    helper_limits.progress = nullptr;
+    std::vector<uint64_t> helper_nodes(threads, 0);
+    std::vector<std::thread> helpers;
+    for (int i = 1; i < threads; i++) {
+        helpers.emplace_back([&, i]() {
+            SearchResult helper =
+                _threads[i]->search(board, 1 + i % 2, helper_limits);
+            helper_nodes[i] = helper.nodes;
+        });
+    }
+
+    SearchResult result = _threads[0]->search(board, 1, limits);
+    done = true;
+    for (std::thread &helper : helpers) {
+        helper.join();
+    }
+
+    for (uint64_t nodes : helper_nodes) {
+        result.nodes += nodes;
+    }
+    result.seconds = std::chrono::duration<double>(
+                         std::chrono::steady_clock::now() - start)
+                         .count();
+    return result;
+}
+
+size_t SearchThread::memory() {
+    return sizeof(SearchThread) + map_memory(_noise) +
+           _expected.capacity() * sizeof(uint16_t) +
+           _excluded.capacity() * sizeof(brainiac::Move) +
+           _line.capacity() * sizeof(uint64_t);
+}
+
+size_t Engine::memory() {
+    size_t memory = sizeof(Engine);
+    for (auto &thread : _threads) {
+        memory += thread->memory();
+    }
+    return memory;
+}
@@ -0,0 +1,246 @@
+#ifndef ENGINE_H_
+#define ENGINE_H_
+
+#include <atomic>
+#include <brainiac.h>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+#include "table.h"
+#include "tablebase.h"
+
+/**
+ * Score of a checkmate, mates found deeper in the tree score closer to zero
+ */
+constexpr int mate_score = 32000;
+
+/**
+ * Deepest ply the search can reach, including quiescence
+ */
+constexpr int max_ply = 64;
+
+/**
+ * Score of a position the tablebases hold as won, below any mate score
+ */
+constexpr int tablebase_win = mate_score - 2 * max_ply;
+
+/**
+ * Line of play found by a search
+ */
+struct SearchLine {
+    // Centipawns from the perspective of the side to move
+    int score = 0;
+    std::vector<brainiac::Move> pv;
+};
+
+/**
+ * Outcome of a search
+ */
+struct SearchResult {
+    brainiac::Move move;
+
+    // Centipawns from the perspective of the side to move
+    int score = 0;
+    int depth = 0;
+    uint64_t nodes = 0;
+    double seconds = 0;
+
+    // Expected line of play starting with the chosen move
+    std::vector<brainiac::Move> pv;
+
+    // Best lines from best to worst when more than one was searched
+    std::vector<SearchLine> lines;
+};
+
+/**
+ * Constraints on a single search
+ */
+struct SearchLimits {
+    int depth = 6;
+
+    // Nodes searched by the main thread and wall time the search may take,
+    // zero for no limit
+    uint64_t nodes = 0;
+    std::chrono::milliseconds time{0};
+
+    // Threads searching at once, including the calling thread
+    int threads = 1;
+
+    // Random centipawns up to which each root move is scored off, weakening
+    // the choice of move
+    int noise = 0;
+
+    // Number of best lines to find, each after the moves of the better ones
+    // are excluded from the root
+    int lines = 1;
+
+    // Called by the main thread with the result of each completed iteration
+    std::function<void(const SearchResult &)> progress;
+
+    // Stops the search once set, the best move found so far is returned
+    const std::atomic<bool> *stop = nullptr;
+
+    // Stops the search like stop, set when a background search is asked to
+    // make way for regular ones
+    const std::atomic<bool> *yield = nullptr;
+};
+
+/**
+ * Search state of a single thread
+ *
+ * Threads of the same search share only the transposition table.
+ */
+class SearchThread {
+    TranspositionTable &_table;
+    Tablebase *_tablebase;
+
+    brainiac::Move _killers[max_ply][2];
+    int _history[64][64];
+
+    brainiac::Move _pv[max_ply][max_ply];
+    int _pv_length[max_ply];
+
+    // Noise of each root move by its table key
+    std::unordered_map<uint16_t, int> _noise;
+
+    // Root moves of the better lines of a multiple line search
+    std::vector<brainiac::Move> _excluded;
+
+    // Moves of the last principal variation, the hashes of the positions
+    // they lead to, and the first of them still ahead of the current root
+    std::vector<uint16_t> _expected;
+    std::vector<uint64_t> _line;
+    size_t _played = 0;
+
+    // Whether the path to each ply has followed the expected moves, only
+    // then is the expected move worth trying first
+    bool _on_line[max_ply];
+
+    std::mt19937 _random;
+
+    uint64_t _nodes;
+    uint64_t _max_nodes;
+    std::chrono::steady_clock::time_point _deadline;
+    bool _timed;
+    const std::atomic<bool> *_stop;
+    const std::atomic<bool> *_yield;
+    bool _stopped;
+
+    /**
+     * Test if the search should unwind
+     */
+    bool should_stop();
+
+    /**
+     * Carry killers and the expected line over from the last search if the
+     * position was reached along its principal variation, or drop them
+     */
+    void warm_start(brainiac::Board &board);
+
+    /**
+     * Test if a root move belongs to a better line
+     */
+    bool excluded(brainiac::Move move);
+
+    /**
+     * Order moves from most to least promising
+     */
+    void order_moves(brainiac::Board &board,
+                     std::vector<brainiac::Move> &moves,
+                     uint16_t table_move,
+                     int ply);
+
+    /**
+     * Search captures until the position is quiet
+     */
+    int quiescence(brainiac::Board &board, int alpha, int beta, int ply);
+
+    /**
+     * Principal variation search of a position to a depth
+     */
+    int negamax(brainiac::Board &board,
+                int depth,
+                int alpha,
+                int beta,
+                int ply);
+
+  public:
+    SearchThread(TranspositionTable &table, Tablebase *tablebase);
+
+    /**
+     * Search a position by iterative deepening from the first depth up to the
+     * depth limit, or until a budget runs out or the search is stopped
+     *
+     * Iterations are not started past half the time budget, since the next
+     * one would rarely finish in the time left.
+     */
+    SearchResult search(brainiac::Board board,
+                        int first_depth,
+                        const SearchLimits &limits);
+
+    /**
+     * Get the memory used by the thread in bytes
+     */
+    size_t memory();
+};
+
+/**
+ * Iterative deepening alpha-beta search on top of Brainiac's move generation
+ *
+ * An engine keeps its move history between searches and the transposition
+ * table outlives it, so searching successive positions of a game starts
+ * warm. When the game follows the expected line, killers are shifted by the
+ * plies played and the rest of the line is tried first where the table has
+ * lost it. Searches with more than one thread run helpers alongside the main
+ * thread that fill the shared table, only the main thread's result is used.
+ */
+class Engine {
+    TranspositionTable &_table;
+    Tablebase *_tablebase;
+    std::vector<std::unique_ptr<SearchThread>> _threads;
+
+  public:
+    /**
+     * Create an engine on a transposition table, which may be shared with
+     * other engines, and optionally endgame tablebases
+     *
+     * Positions in the tablebases are played from them without a search,
+     * and captures into them are scored by a probe.
+     */
+    Engine(TranspositionTable &table, Tablebase *tablebase = nullptr);
+
+    /**
+     * Search a position for the best move
+     */
+    SearchResult search(brainiac::Board board, SearchLimits limits);
+
+    /**
+     * Get the memory used by the engine in bytes, not counting its table
+     */
+    size_t memory();
+};
+
+/**
+ * Index of a piece type from pawn to king, the order of the evaluation
+ * tables, Polyglot keys and Fathom's bitboards
+ *
+ * Brainiac orders its piece types differently, so they are never cast.
+ */
+int type_index(brainiac::PieceType type);
+
+/**
+ * Static evaluation of a position from the perspective of the side to move
+ */
+int evaluate(brainiac::Board &board);
+
+/**
+ * Test if two moves are the same
+ */
+bool same_move(brainiac::Move a, brainiac::Move b);
+
+#endif
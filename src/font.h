@@ -0,0 +1,20 @@
+#ifndef FONT_H_
+#define FONT_H_
+
+#include <cstdint>
+
+/**
+ * Dimensions of a glyph in the bitmap font
+ */
+constexpr int glyph_width = 5;
+constexpr int glyph_height = 7;
+
+/**
+ * Get the rows of a 5x7 glyph, most significant of the 5 bits on the left
+ *
+ * Covers digits, uppercase letters (lowercase is mapped to uppercase) and a
+ * few symbols. Unknown characters are drawn blank.
+ */
+const uint8_t *get_glyph(char c);
+
+#endif
@@ -2,6 +2,10 @@
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 #include "image.h"
 
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
 Image::Image(int width, int height) : width(width), height(height) {
     from_file = false;
     data = new unsigned char[(width * height) * 4];
@@ -84,8 +88,217 @@ void Image::draw(Image *image, int x, int y) {
     }
 }
 
+void Image::draw_slice(Image *image, int x, int y, int src_x, int w) {
+    for (int row = 0; row < image->height; row++) {
+        for (int col = src_x; col < src_x + w && col < image->width; col++) {
+            draw_at(image->get_at(col, row), x + col - src_x, y + row);
+        }
+    }
+}
+
+void Image::blit(Image *image, int x, int y) {
+    int row_bytes = std::min(image->width, width - x) * 4;
+    if (x < 0 || row_bytes <= 0) return;
+    for (int row = 0; row < image->height && y + row < height; row++) {
+        std::memcpy(data + (y + row) * (width * 4) + (x * 4),
+                    image->data + row * (image->width * 4),
+                    row_bytes);
+    }
+}
+
+/**
+ * Subpixel precision of the rasterizer, in bits per pixel along the x-axis
+ */
+constexpr int subpixel_bits = 8;
+constexpr int subpixel = 1 << subpixel_bits;
+
+/**
+ * Number of scanlines sampled per row of pixels
+ */
+constexpr int samples = 4;
+
+void Image::fill_polygon(const std::vector<std::vector<Point>> &contours,
+                         Color color) {
+    // Convert to fixed point and find the bounds of the shape
+    struct Edge {
+        int64_t x0, y0, x1, y1;
+    };
+    std::vector<Edge> edges;
+    int64_t min_y = INT64_MAX;
+    int64_t max_y = INT64_MIN;
+    int64_t min_x = INT64_MAX;
+    int64_t max_x = INT64_MIN;
+    for (const std::vector<Point> &contour : contours) {
+        for (int i = 0; i < contour.size(); i++) {
+            const Point &a = contour[i];
+            const Point &b = contour[(i + 1) % contour.size()];
+            Edge edge = {std::llround(a.x * subpixel),
+                         std::llround(a.y * subpixel),
+                         std::llround(b.x * subpixel),
+                         std::llround(b.y * subpixel)};
+            min_x = std::min({min_x, edge.x0, edge.x1});
+            max_x = std::max({max_x, edge.x0, edge.x1});
+            min_y = std::min({min_y, edge.y0, edge.y1});
+            max_y = std::max({max_y, edge.y0, edge.y1});
+            if (edge.y0 != edge.y1) edges.push_back(edge);
+        }
+    }
+    if (edges.empty()) return;
+
+    int row_start = std::max<int64_t>(0, min_y >> subpixel_bits);
+    int row_end = std::min<int64_t>(height - 1, max_y >> subpixel_bits);
+    int col_start = std::max<int64_t>(0, min_x >> subpixel_bits);
+    int col_end = std::min<int64_t>(width - 1, max_x >> subpixel_bits);
+    if (row_start > row_end || col_start > col_end) return;
+
+    int span = col_end - col_start + 1;
+    std::vector<int> cover(span + 1);
+    std::vector<int> delta(span + 1);
+    std::vector<int64_t> crossings;
+    int r = 255 * color.r;
+    int g = 255 * color.g;
+    int b = 255 * color.b;
+    int a = 255 * color.a;
+
+    int64_t x_lo = static_cast<int64_t>(col_start) << subpixel_bits;
+    int64_t x_hi = static_cast<int64_t>(col_end + 1) << subpixel_bits;
+    for (int row = row_start; row <= row_end; row++) {
+        std::fill(cover.begin(), cover.end(), 0);
+        std::fill(delta.begin(), delta.end(), 0);
+        for (int s = 0; s < samples; s++) {
+            int64_t y = (static_cast<int64_t>(row) << subpixel_bits) +
+                        (2 * s + 1) * subpixel / (2 * samples);
+            crossings.clear();
+            for (const Edge &edge : edges) {
+                int64_t lo = std::min(edge.y0, edge.y1);
+                int64_t hi = std::max(edge.y0, edge.y1);
+                if (y < lo || y >= hi) continue;
+                crossings.push_back(edge.x0 + (y - edge.y0) *
+                                                  (edge.x1 - edge.x0) /
+                                                  (edge.y1 - edge.y0));
+            }
+            std::sort(crossings.begin(), crossings.end());
+
+            // Accumulate partial coverage at the ends of each span, and full
+            // coverage of the pixels in between as a running sum
+            for (int i = 0; i + 1 < crossings.size(); i += 2) {
+                int64_t x0 = std::clamp(crossings[i], x_lo, x_hi) - x_lo;
+                int64_t x1 = std::clamp(crossings[i + 1], x_lo, x_hi) - x_lo;
+                int c0 = x0 >> subpixel_bits;
+                int c1 = x1 >> subpixel_bits;
+                if (c0 == c1) {
+                    cover[c0] += x1 - x0;
+                } else {
+                    cover[c0] += subpixel - (x0 & (subpixel - 1));
+                    cover[c1] += x1 & (subpixel - 1);
+                    delta[c0 + 1] += subpixel;
+                    delta[c1] -= subpixel;
+                }
+            }
+        }
+
+        int full = 0;
+        unsigned char *pixel = data + (row * width + col_start) * 4;
+        for (int col = 0; col < span; col++, pixel += 4) {
+            full += delta[col];
+            int coverage = cover[col] + full;
+            if (coverage == 0) continue;
+            int alpha = a * coverage / (subpixel * samples);
+            int inverse = 255 - alpha;
+            pixel[0] = (r * alpha + pixel[0] * inverse + 127) / 255;
+            pixel[1] = (g * alpha + pixel[1] * inverse + 127) / 255;
+            pixel[2] = (b * alpha + pixel[2] * inverse + 127) / 255;
+            pixel[3] = alpha + (pixel[3] * inverse + 127) / 255;
+        }
+    }
+}
+
+void Image::draw_line(Point from, Point to, double thickness, Color color) {
+    double dx = to.x - from.x;
+    double dy = to.y - from.y;
+    double length = std::hypot(dx, dy);
+    if (length == 0) return;
+
+    // Normal of the segment scaled to half the thickness
+    double nx = -dy / length * thickness / 2;
+    double ny = dx / length * thickness / 2;
+    fill_polygon({{
+                     {from.x + nx, from.y + ny},
+                     {to.x + nx, to.y + ny},
+                     {to.x - nx, to.y - ny},
+                     {from.x - nx, from.y - ny},
+                 }},
+                 color);
+}
+
+void Image::draw_arrow(Point from, Point to, double thickness, Color color) {
+    double dx = to.x - from.x;
+    double dy = to.y - from.y;
+    double length = std::hypot(dx, dy);
+    if (length == 0) return;
+
+    // Head is proportional to the thickness, but never longer than the arrow
+    double head_length = std::min(length, thickness * 2.5);
+    double head_width = thickness * 1.5;
+    double ux = dx / length;
+    double uy = dy / length;
+    double nx = -uy * thickness / 2;
+    double ny = ux * thickness / 2;
+    double hx = -uy * head_width;
+    double hy = ux * head_width;
+    Point base = {to.x - ux * head_length, to.y - uy * head_length};
+    fill_polygon({{
+                     {from.x + nx, from.y + ny},
+                     {base.x + nx, base.y + ny},
+                     {base.x + hx, base.y + hy},
+                     to,
+                     {base.x - hx, base.y - hy},
+                     {base.x - nx, base.y - ny},
+                     {from.x - nx, from.y - ny},
+                 }},
+                 color);
+}
+
+void Image::draw_ring(Point center,
+                      double radius,
+                      double thickness,
+                      Color color) {
+    // Enough segments that the polygon is indistinguishable from a circle
+    int segments = std::max(16, static_cast<int>(radius));
+    std::vector<Point> outer;
+    std::vector<Point> inner;
+    double inner_radius = std::max(0.0, radius - thickness);
+    for (int i = 0; i < segments; i++) {
+        double angle = 2 * M_PI * i / segments;
+        double c = std::cos(angle);
+        double s = std::sin(angle);
+        outer.push_back({center.x + c * radius, center.y + s * radius});
+        inner.push_back(
+            {center.x + c * inner_radius, center.y + s * inner_radius});
+    }
+    fill_polygon({outer, inner}, color);
+}
+
 void Image::save(std::string filename) {
     int success =
         stbi_write_png(filename.c_str(), width, height, 4, data, 4 * width);
     assert(success);
+}
+
+std::string Image::encode() {
+    std::string png;
+    int success = stbi_write_png_to_func(
+        [](void *context, void *data, int size) {
+            static_cast<std::string *>(context)->append(
+                static_cast<char *>(data),
+                size);
+        },
+        &png,
+        width,
+        height,
+        4,
+        data,
+        4 * width);
+    assert(success);
+    return png;
 }
\ No newline at end of file
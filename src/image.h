@@ -2,6 +2,7 @@
 #define IMAGE_H_
 
 #include <string>
+#include <vector>
 
 #include "util/stb_image.h"
 #include "util/stb_image_write.h"
@@ -16,6 +17,14 @@ struct Color {
     double a;
 };
 
+/**
+ * Position in pixel coordinates
+ */
+struct Point {
+    double x;
+    double y;
+};
+
 /**
  * Image is a pixel sheet that can be both drawn and drawn to
  */
@@ -56,10 +65,51 @@ struct Image {
      */
     void draw(Image *image, int x, int y);
 
+    /**
+     * Draw the columns [src_x, src_x + w) of another image with its top left
+     * corner at (x, y)
+     */
+    void draw_slice(Image *image, int x, int y, int src_x, int w);
+
+    /**
+     * Overwrite a region with another image without blending
+     */
+    void blit(Image *image, int x, int y);
+
+    /**
+     * Fill a shape made of one or more closed contours with anti-aliasing
+     *
+     * Overlapping contours are combined with the even-odd rule, so holes can
+     * be cut by adding an inner contour. Coverage is computed in fixed point
+     * and only the rows spanned by the shape are written.
+     */
+    void fill_polygon(const std::vector<std::vector<Point>> &contours,
+                      Color color);
+
+    /**
+     * Draw a line segment of some thickness
+     */
+    void draw_line(Point from, Point to, double thickness, Color color);
+
+    /**
+     * Draw a line segment ending in an arrow head
+     */
+    void draw_arrow(Point from, Point to, double thickness, Color color);
+
+    /**
+     * Draw the outline of a circle
+     */
+    void draw_ring(Point center, double radius, double thickness, Color color);
+
     /**
      * Save an image to disk (as a png)
      */
     void save(std::string filename);
+
+    /**
+     * Encode the image as a png in memory
+     */
+    std::string encode();
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,378 @@
+#include "moves.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+
+/**
+ * Promotion piece of a move, zero if it is not a promotion
+ */
+char promotion_of(brainiac::Move move) {
+    std::string notation = move.standard_notation();
+    return notation.size() > 4 ? std::tolower(notation[4]) : 0;
+}
+
+/**
+ * Letter of a piece type in algebraic notation, pawns have none
+ */
+char piece_letter(brainiac::PieceType type) {
+    switch (type) {
+    case brainiac::PieceType::Knight:
+        return 'N';
+    case brainiac::PieceType::Bishop:
+        return 'B';
+    case brainiac::PieceType::Rook:
+        return 'R';
+    case brainiac::PieceType::Queen:
+        return 'Q';
+    case brainiac::PieceType::King:
+        return 'K';
+    default:
+        return 0;
+    }
+}
+
+/**
+ * Piece type of a letter in algebraic notation in either case
+ */
+brainiac::PieceType letter_piece(char letter) {
+    switch (std::toupper(letter)) {
+    case 'N':
+        return brainiac::PieceType::Knight;
+    case 'B':
+        return brainiac::PieceType::Bishop;
+    case 'R':
+        return brainiac::PieceType::Rook;
+    case 'Q':
+        return brainiac::PieceType::Queen;
+    case 'K':
+        return brainiac::PieceType::King;
+    default:
+        return brainiac::PieceType::Pawn;
+    }
+}
+
+/**
+ * Test if a move is castling, the king moving two files
+ */
+bool is_castling(brainiac::Move move, brainiac::PieceType piece) {
+    return piece == brainiac::PieceType::King &&
+           std::abs(move.get_to() % 8 - move.get_from() % 8) == 2;
+}
+
+std::string square_name(int square) {
+    return {char('a' + square % 8), char('1' + square / 8)};
+}
+
+brainiac::Square parse_square(const std::string &input, size_t offset) {
+    if (input.size() < offset + 2) return brainiac::Square::Null;
+    char file = std::tolower(input[offset]);
+    char rank = input[offset + 1];
+    if (file < 'a' || file > 'h' || rank < '1' || rank > '8') {
+        return brainiac::Square::Null;
+    }
+    return static_cast<brainiac::Square>((rank - '1') * 8 + (file - 'a'));
+}
+
+void MoveIndex::update(brainiac::Board &board) {
+    uint64_t hash = board.get_hash();
+    if (_valid && hash == _hash) return;
+    _hash = hash;
+    _valid = true;
+
+    _moves = board.get_moves();
+    std::stable_sort(_moves.begin(),
+                     _moves.end(),
+                     [](brainiac::Move a, brainiac::Move b) {
+                         return a.get_from() * 64 + a.get_to() <
+                                b.get_from() * 64 + b.get_to();
+                     });
+    _pieces.clear();
+    std::memset(_count, 0, sizeof(_count));
+    for (size_t i = 0; i < _moves.size(); i++) {
+        int from = _moves[i].get_from();
+        int to = _moves[i].get_to();
+        if (_count[from][to]++ == 0) {
+            _first[from][to] = i;
+        }
+        _pieces.push_back(board.get_at_coords(from / 8, from % 8).get_type());
+    }
+}
+
+int MoveIndex::index_of(brainiac::Move move) const {
+    int from = move.get_from();
+    int to = move.get_to();
+    if (from >= 64 || to >= 64) return -1;
+    for (int i = _first[from][to]; i < _first[from][to] + _count[from][to];
+         i++) {
+        if (promotion_of(_moves[i]) == promotion_of(move)) return i;
+    }
+    return -1;
+}
+
+const std::vector<brainiac::Move> &MoveIndex::moves() const {
+    return _moves;
+}
+
+std::vector<brainiac::Move> MoveIndex::between(brainiac::Square from,
+                                               brainiac::Square to) const {
+    if (from >= 64 || to >= 64 || _count[from][to] == 0) return {};
+    auto first = _moves.begin() + _first[from][to];
+    return {first, first + _count[from][to]};
+}
+
+std::vector<brainiac::Move> MoveIndex::from(brainiac::Square square) const {
+    std::vector<brainiac::Move> moves;
+    if (square >= 64) return moves;
+    for (int to = 0; to < 64; to++) {
+        if (_count[square][to] == 0) continue;
+        auto first = _moves.begin() + _first[square][to];
+        moves.insert(moves.end(), first, first + _count[square][to]);
+    }
+    return moves;
+}
+
+std::vector<brainiac::Move> MoveIndex::to(brainiac::Square square) const {
+    std::vector<brainiac::Move> moves;
+    if (square >= 64) return moves;
+    for (int from = 0; from < 64; from++) {
+        if (_count[from][square] == 0) continue;
+        auto first = _moves.begin() + _first[from][square];
+        moves.insert(moves.end(), first, first + _count[from][square]);
+    }
+    return moves;
+}
+
+brainiac::Move MoveIndex::find(brainiac::Square from,
+                               brainiac::Square to,
+                               char promotion) const {
+    if (from >= 64 || to >= 64) return brainiac::Move();
+    int first = _first[from][to];
+    int count = _count[from][to];
+    if (count == 1 && promotion_of(_moves[first]) == 0) {
+        return _moves[first];
+    }
+    for (int i = first; i < first + count; i++) {
+        if (promotion_of(_moves[i]) == std::tolower(promotion)) {
+            return _moves[i];
+        }
+    }
+    return brainiac::Move();
+}
+
+brainiac::Move MoveIndex::parse(std::string input,
+                                std::vector<brainiac::Move> &candidates) const {
+    candidates.clear();
+    input.erase(std::remove_if(input.begin(),
+                               input.end(),
+                               [](char c) { return std::isspace(c); }),
+                input.end());
+    std::string coordinates = input;
+    coordinates.erase(std::remove_if(coordinates.begin(),
+                                     coordinates.end(),
+                                     [](char c) { return c == '-'; }),
+                      coordinates.end());
+    brainiac::Square from = parse_square(coordinates, 0);
+    brainiac::Square to = parse_square(coordinates, 2);
+    char promotion = coordinates.size() == 5 ? coordinates[4] : 0;
+    if (coordinates.size() <= 5 && from != brainiac::Square::Null &&
+        to != brainiac::Square::Null) {
+        brainiac::Move move = find(from, to, promotion);
+        if (!move.is_invalid()) return move;
+        candidates = between(from, to);
+        if (candidates.size()) return brainiac::Move();
+    }
+
+    // Algebraic input that fits several moves is answered with those
+    std::vector<brainiac::Move> ambiguous;
+    brainiac::Move move = parse_san(input, ambiguous);
+    if (!move.is_invalid()) {
+        candidates.clear();
+        return move;
+    }
+    if (ambiguous.size()) {
+        candidates = ambiguous;
+        return brainiac::Move();
+    }
+
+    if (from != brainiac::Square::Null) {
+        candidates = this->from(from);
+        if (candidates.empty() && coordinates.size() == 2) {
+            candidates = this->to(from);
+        }
+    }
+    if (candidates.empty() && to != brainiac::Square::Null) {
+        candidates = this->to(to);
+    }
+    return brainiac::Move();
+}
+
+brainiac::Move MoveIndex::parse_san(
+    std::string input,
+    std::vector<brainiac::Move> &candidates) const {
+    candidates.clear();
+    while (input.size() && std::strchr("+#!?", input.back())) {
+        input.pop_back();
+    }
+
+    // Castling is written with letter O or digit zero
+    std::string castling = input;
+    std::replace(castling.begin(), castling.end(), '0', 'O');
+    std::transform(castling.begin(),
+                   castling.end(),
+                   castling.begin(),
+                   ::toupper);
+    if (castling == "O-O" || castling == "OO" || castling == "O-O-O" ||
+        castling == "OOO") {
+        // Two letters castle kingside and three queenside
+        int letters = std::count(castling.begin(), castling.end(), 'O');
+        int direction = letters == 2 ? 2 : -2;
+        for (size_t i = 0; i < _moves.size(); i++) {
+            brainiac::Move move = _moves[i];
+            if (is_castling(move, _pieces[i]) &&
+                move.get_to() - move.get_from() == direction) {
+                return move;
+            }
+        }
+        return brainiac::Move();
+    }
+
+    // Promotion piece, either after = or directly after the last rank
+    char promotion = 0;
+    size_t equals = input.find('=');
+    if (equals != std::string::npos) {
+        if (equals + 1 < input.size()) {
+            promotion = std::tolower(input[equals + 1]);
+        }
+        input.erase(equals);
+    } else if (input.size() >= 3 && std::isdigit(input[input.size() - 2]) &&
+               std::strchr("qrbnQRBN", input.back())) {
+        promotion = std::tolower(input.back());
+        input.pop_back();
+    }
+
+    // The destination comes last, any piece letter first, and what is left
+    // narrows down the square the piece comes from
+    if (input.size() < 2) return brainiac::Move();
+    brainiac::Square to = parse_square(input, input.size() - 2);
+    if (to == brainiac::Square::Null) return brainiac::Move();
+    input.erase(input.size() - 2);
+    input.erase(std::remove_if(input.begin(),
+                               input.end(),
+                               [](char c) { return c == 'x' || c == ':'; }),
+                input.end());
+
+    // A lowercase b is a pawn file unless no pawn move fits, other piece
+    // letters are taken in either case
+    std::vector<std::pair<brainiac::PieceType, std::string>> readings;
+    if (input.size() && std::strchr("NBRQKnrqk", input[0])) {
+        readings.push_back({letter_piece(input[0]), input.substr(1)});
+    } else {
+        readings.push_back({brainiac::PieceType::Pawn, input});
+        if (input.size() && input[0] == 'b') {
+            readings.push_back({brainiac::PieceType::Bishop, input.substr(1)});
+        }
+    }
+
+    for (auto &reading : readings) {
+        brainiac::PieceType piece = reading.first;
+        int file = -1;
+        int rank = -1;
+        for (char c : reading.second) {
+            if (c >= 'a' && c <= 'h') {
+                file = c - 'a';
+            } else if (c >= '1' && c <= '8') {
+                rank = c - '1';
+            } else {
+                return brainiac::Move();
+            }
+        }
+
+        std::vector<brainiac::Move> matches;
+        for (int square = 0; square < 64; square++) {
+            if (file >= 0 && square % 8 != file) continue;
+            if (rank >= 0 && square / 8 != rank) continue;
+            int first = _first[square][to];
+            for (int i = first; i < first + _count[square][to]; i++) {
+                if (_pieces[i] != piece || is_castling(_moves[i], piece)) {
+                    continue;
+                }
+                char move_promotion = promotion_of(_moves[i]);
+                if (promotion && move_promotion != promotion) continue;
+                matches.push_back(_moves[i]);
+            }
+        }
+        if (matches.size() == 1 && (promotion || !promotion_of(matches[0]))) {
+            return matches[0];
+        }
+        if (matches.size()) {
+            candidates = matches;
+            return brainiac::Move();
+        }
+    }
+    return brainiac::Move();
+}
+
+std::string MoveIndex::san(brainiac::Board &board,
+                           brainiac::Move move) const {
+    int index = index_of(move);
+    if (index < 0) return move.standard_notation();
+    brainiac::PieceType piece = _pieces[index];
+    int from = move.get_from();
+    int to = move.get_to();
+
+    std::string notation;
+    if (is_castling(move, piece)) {
+        notation = to > from ? "O-O" : "O-O-O";
+    } else {
+        bool capture = !board.get_at_coords(to / 8, to % 8).is_empty() ||
+                       (piece == brainiac::PieceType::Pawn &&
+                        from % 8 != to % 8);
+        if (piece == brainiac::PieceType::Pawn) {
+            if (capture) {
+                notation += char('a' + from % 8);
+            }
+        } else {
+            notation += piece_letter(piece);
+
+            // Name the file, rank or both if other pieces of the same type
+            // can also move there
+            bool other = false;
+            bool same_file = false;
+            bool same_rank = false;
+            for (int square = 0; square < 64; square++) {
+                if (square == from || _count[square][to] == 0) continue;
+                if (_pieces[_first[square][to]] != piece) continue;
+                other = true;
+                same_file |= square % 8 == from % 8;
+                same_rank |= square / 8 == from / 8;
+            }
+            if (other && !same_file) {
+                notation += char('a' + from % 8);
+            } else if (other && !same_rank) {
+                notation += char('1' + from / 8);
+            } else if (other) {
+                notation += square_name(from);
+            }
+        }
+        if (capture) {
+            notation += 'x';
+        }
+        notation += square_name(to);
+        char promotion = promotion_of(move);
+        if (promotion) {
+            notation += '=';
+            notation += std::toupper(promotion);
+        }
+    }
+
+    board.make_move(move);
+    if (board.is_checkmate()) {
+        notation += '#';
+    } else if (board.is_check()) {
+        notation += '+';
+    }
+    board.undo_move();
+    return notation;
+}
@@ -0,0 +1,112 @@
+#ifndef MOVES_H_
+#define MOVES_H_
+
+#include <brainiac.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * Legal moves of a position indexed by their squares
+ *
+ * Moves are generated once per position, after which validating input and
+ * listing candidate moves are table lookups rather than calls into move
+ * generation.
+ */
+class MoveIndex {
+    uint64_t _hash = 0;
+    bool _valid = false;
+
+    // Legal moves ordered by their squares, so promotions between the same
+    // squares are next to each other, and the type of piece each one moves
+    std::vector<brainiac::Move> _moves;
+    std::vector<brainiac::PieceType> _pieces;
+
+    // First index of the moves between two squares and how many there are
+    uint8_t _first[64][64] = {};
+    uint8_t _count[64][64] = {};
+
+    /**
+     * Find the legal move written in standard algebraic notation, such as
+     * Nf3, exd5, O-O or e8=Q+
+     *
+     * If the input fits more than one move, candidates is filled with them.
+     */
+    brainiac::Move parse_san(std::string input,
+                             std::vector<brainiac::Move> &candidates) const;
+
+    /**
+     * Get the index of a legal move, or -1 if it is not one
+     */
+    int index_of(brainiac::Move move) const;
+
+  public:
+    /**
+     * Index the legal moves of a position, unless it is already indexed
+     */
+    void update(brainiac::Board &board);
+
+    /**
+     * Get every legal move of the position
+     */
+    const std::vector<brainiac::Move> &moves() const;
+
+    /**
+     * Get the legal moves between two squares, more than one if they are
+     * promotions
+     */
+    std::vector<brainiac::Move> between(brainiac::Square from,
+                                        brainiac::Square to) const;
+
+    /**
+     * Get the legal moves from a square
+     */
+    std::vector<brainiac::Move> from(brainiac::Square square) const;
+
+    /**
+     * Get the legal moves to a square
+     */
+    std::vector<brainiac::Move> to(brainiac::Square square) const;
+
+    /**
+     * Find the legal move between two squares, the promotion piece is needed
+     * only if the move is a promotion
+     */
+    brainiac::Move find(brainiac::Square from,
+                        brainiac::Square to,
+                        char promotion = 0) const;
+
+    /**
+     * Find the legal move written in coordinate notation, such as e2e4 or
+     * e7e8q, or in standard algebraic notation, such as Nf3 or exd5
+     *
+     * If there is none, candidates is filled with the moves the input could
+     * have meant. These are the moves fitting ambiguous algebraic input, the
+     * promotions between its squares if the piece is missing, the moves from
+     * its first square if that has any, and otherwise the moves to its last
+     * square.
+     */
+    brainiac::Move parse(std::string input,
+                         std::vector<brainiac::Move> &candidates) const;
+
+    /**
+     * Write a legal move of the indexed position in standard algebraic
+     * notation
+     *
+     * The move is played and taken back on the board to tell if it gives
+     * check or mate.
+     */
+    std::string san(brainiac::Board &board, brainiac::Move move) const;
+};
+
+/**
+ * Parse a square such as e4, returns Null if the input is not one
+ */
+brainiac::Square parse_square(const std::string &input, size_t offset = 0);
+
+/**
+ * Get the name of a square such as e4
+ */
+std::string square_name(int square);
+
+#endif
@@ -0,0 +1,75 @@
+#include "pool.h"
+
+#include <algorithm>
+
+EnginePool::EnginePool(TranspositionTable &table,
+                       Tablebase *tablebase,
+                       size_t budget) :
+    _table(table), _tablebase(tablebase), _budget(budget) {}
+
+void EnginePool::evict() {
+    while (_memory > _budget && !_idle.empty()) {
+        auto it = _engines.find(_idle.back());
+        _memory -= it->second.memory;
+        _engines.erase(it);
+        _idle.pop_back();
+    }
+}
+
+Engine &EnginePool::checkout(uint64_t game_id) {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _returned.wait(lock, [&]() {
+        auto it = _engines.find(game_id);
+        return it == _engines.end() || !it->second.checked_out;
+    });
+
+    Entry &entry = _engines[game_id];
+    if (entry.engine) {
+        _idle.erase(entry.idle);
+    } else {
+        entry.engine = std::make_unique<Engine>(_table, _tablebase);
+        entry.memory = entry.engine->memory();
+        _memory += entry.memory;
+        evict();
+    }
+    entry.checked_out = true;
+    return *entry.engine;
+}
+
+void EnginePool::checkin(uint64_t game_id) {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        Entry &entry = _engines[game_id];
+        _memory -= entry.memory;
+        if (entry.released) {
+            _engines.erase(game_id);
+        } else {
+            // Searches on more threads leave the engine larger
+            entry.memory = entry.engine->memory();
+            _memory += entry.memory;
+            entry.checked_out = false;
+            _idle.push_front(game_id);
+            entry.idle = _idle.begin();
+            evict();
+        }
+    }
+    _returned.notify_all();
+}
+
+void EnginePool::release(uint64_t game_id) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto it = _engines.find(game_id);
+    if (it == _engines.end()) return;
+    if (it->second.checked_out) {
+        it->second.released = true;
+    } else {
+        _memory -= it->second.memory;
+        _idle.erase(it->second.idle);
+        _engines.erase(it);
+    }
+}
+
+size_t EnginePool::size() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _engines.size();
+}
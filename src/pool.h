@@ -0,0 +1,89 @@
+#ifndef POOL_H_
+#define POOL_H_
+
+#include <condition_variable>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+#include "engine.h"
+
+/**
+ * Search engines assigned to games
+ *
+ * A game checks out the same engine for every search so state like its move
+ * history carries over between moves. Every engine searches on the same
+ * transposition table. Idle engines are evicted least recently used first
+ * once the pool exceeds its memory budget, engines that searched on more
+ * threads counting for more.
+ */
+class EnginePool {
+    struct Entry {
+        std::unique_ptr<Engine> engine;
+        bool checked_out = false;
+
+        // Memory of the engine when it was last checked in
+        size_t memory = 0;
+
+        // Game ended while the engine was checked out
+        bool released = false;
+
+        // Position in the idle list, valid while not checked out
+        std::list<uint64_t>::iterator idle;
+    };
+
+    std::unordered_map<uint64_t, Entry> _engines;
+
+    // Idle engines by game id, most recently used first
+    std::list<uint64_t> _idle;
+
+    TranspositionTable &_table;
+    Tablebase *_tablebase;
+    size_t _budget;
+
+    // Memory of all engines as of their last checkin
+    size_t _memory = 0;
+
+    std::mutex _mutex;
+    std::condition_variable _returned;
+
+    /**
+     * Evict idle engines until the pool fits its budget
+     */
+    void evict();
+
+  public:
+    /**
+     * Create a pool of engines searching on a table and optionally endgame
+     * tablebases, with a memory budget in bytes for the engines themselves
+     */
+    EnginePool(TranspositionTable &table,
+               Tablebase *tablebase,
+               size_t budget);
+
+    /**
+     * Check out the engine of a game, creating one if it has none
+     *
+     * Waits if the engine is already checked out.
+     */
+    Engine &checkout(uint64_t game_id);
+
+    /**
+     * Return the engine of a game to the pool
+     */
+    void checkin(uint64_t game_id);
+
+    /**
+     * Discard the engine of a game that is over
+     */
+    void release(uint64_t game_id);
+
+    /**
+     * Get the number of engines currently allocated
+     */
+    size_t size();
+};
+
+#endif
@@ -0,0 +1,410 @@
+#include "render.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+#include "engine.h"
+
+/**
+ * Cell key of an empty square
+ */
+constexpr int empty_key = 12;
+
+/**
+ * Colors of the sidebar
+ */
+constexpr Color background = {0.08, 0.08, 0.08, 1.0};
+constexpr Color text_color = {0.85, 0.85, 0.85, 1.0};
+constexpr Color bar_colors[2] = {
+    {0.93, 0.93, 0.93, 1.0},
+    {0.25, 0.25, 0.25, 1.0},
+};
+
+/**
+ * Layout of the sidebar, the bar lives in the left border and the text in the
+ * bottom border
+ */
+constexpr int glyph_scale = 3;
+constexpr int bar_x = 8;
+constexpr int bar_width = 16;
+
+/**
+ * Horizontal offset of a piece within its tile
+ */
+int piece_offset(brainiac::Piece piece) {
+    if (piece.get_type() == brainiac::PieceType::Pawn ||
+        piece.get_type() == brainiac::PieceType::Knight ||
+        piece.get_type() == brainiac::PieceType::Rook) {
+        return 10;
+    }
+    return 0;
+}
+
+BoardRenderer::BoardRenderer(std::string image_dir, size_t max_canvases) :
+    _image_dir(image_dir), _max_canvases(std::max<size_t>(max_canvases, 1)) {
+    for (int i = 0; i < 12; i++) {
+        _pieces[i] = std::make_unique<Image>(image_dir + std::to_string(i) +
+                                             ".png");
+        _offsets[i] = -1;
+    }
+    _tiles[0] = std::make_unique<Image>(image_dir + "brown0.png");
+    _tiles[1] = std::make_unique<Image>(image_dir + "brown1.png");
+
+    _footer_row = std::make_unique<Image>(size, 1);
+    _footer_row->fill(background);
+    _margin_row = std::make_unique<Image>(border, 1);
+    _margin_row->fill(background);
+    for (int i = 0; i < 2; i++) {
+        _bar_rows[i] = std::make_unique<Image>(bar_width, 1);
+        _bar_rows[i]->fill(bar_colors[i]);
+    }
+}
+
+Image *BoardRenderer::get_cell(int tile, int piece) {
+    std::lock_guard<std::mutex> lock(_cells_mutex);
+    std::unique_ptr<Image> &cell = _cells[tile * 13 + piece];
+    if (!cell) {
+        cell = std::make_unique<Image>(cell_size, cell_size);
+        cell->blit(_tiles[tile].get(), 0, 0);
+        if (piece != empty_key) {
+            Image *piece_image = _pieces[piece].get();
+            int width = std::min(piece_image->width,
+                                 cell_size - _offsets[piece]);
+            cell->draw_slice(piece_image, _offsets[piece], 0, 0, width);
+        }
+    }
+    return cell.get();
+}
+
+Image *BoardRenderer::get_glyph(char c) {
+    std::lock_guard<std::mutex> lock(_cells_mutex);
+    std::unique_ptr<Image> &glyph = _glyphs[c & 127];
+    if (!glyph) {
+        glyph = std::make_unique<Image>(glyph_width * glyph_scale,
+                                        glyph_height * glyph_scale);
+        glyph->fill(background);
+        const uint8_t *rows = ::get_glyph(c);
+        for (int y = 0; y < glyph->height; y++) {
+            for (int x = 0; x < glyph->width; x++) {
+                int bit = glyph_width - 1 - x / glyph_scale;
+                if (rows[y / glyph_scale] & (1 << bit)) {
+                    glyph->set_at(text_color, x, y);
+                }
+            }
+        }
+    }
+    return glyph.get();
+}
+
+std::shared_ptr<BoardRenderer::Canvas>
+BoardRenderer::get_canvas(uint64_t game_id, Orientation orientation) {
+    std::lock_guard<std::mutex> lock(_canvases_mutex);
+    uint64_t key = game_id * 2 + static_cast<uint64_t>(orientation);
+    auto it = _canvases.find(key);
+    if (it != _canvases.end()) {
+        _used.splice(_used.begin(), _used, it->second.used);
+        return it->second.canvas;
+    }
+
+    if (_canvases.size() >= _max_canvases) {
+        _canvases.erase(_used.back());
+        _used.pop_back();
+    }
+    std::shared_ptr<Canvas> canvas = std::make_shared<Canvas>();
+    canvas->image = std::make_unique<Image>(size, size);
+    canvas->image->fill(background);
+    canvas->keys.fill(-1);
+    _used.push_front(key);
+    _canvases[key] = {canvas, _used.begin()};
+    return canvas;
+}
+
+void BoardRenderer::update(Canvas &canvas,
+                           brainiac::Board &board,
+                           Orientation orientation) {
+    for (int row = 0; row < 8; row++) {
+        // Piece on the left whose sprite may spill over the current cell
+        int spill = empty_key;
+        for (int col = 0; col < 9; col++) {
+            int piece = empty_key;
+            int rank = 7 - row;
+            int file = col;
+            if (orientation == Orientation::Black) {
+                rank = row;
+                file = 7 - col;
+            }
+            if (col < 8) {
+                brainiac::Piece square = board.get_at_coords(rank, file);
+                if (!square.is_empty()) {
+                    piece = square.get_index();
+                    if (_offsets[piece] < 0) {
+                        _offsets[piece] = piece_offset(square);
+                    }
+                }
+            }
+
+            // Only redraw the cell if it looks different from last time
+            int key = spill * 13 + piece;
+            int x = col * cell_size + border;
+            int y = row * cell_size + border;
+            if (canvas.keys[row * 9 + col] != key) {
+                canvas.keys[row * 9 + col] = key;
+                if (col < 8) {
+                    int tile = (rank + file) % 2;
+                    if (spill == empty_key) {
+                        canvas.image->blit(get_cell(tile, piece), x, y);
+                    } else {
+                        // Keep the spilled part under this cell's piece
+                        canvas.image->blit(get_cell(tile, empty_key), x, y);
+                        canvas.image->draw_slice(_pieces[spill].get(),
+                                                 x,
+                                                 y,
+                                                 cell_size - _offsets[spill],
+                                                 cell_size);
+                        if (piece != empty_key) {
+                            canvas.image->draw_slice(_pieces[piece].get(),
+                                                     x + _offsets[piece],
+                                                     y,
+                                                     0,
+                                                     cell_size -
+                                                         _offsets[piece]);
+                        }
+                    }
+                } else {
+                    for (int i = 0; i < cell_size; i++) {
+                        canvas.image->blit(_margin_row.get(), x, y + i);
+                    }
+                    if (spill != empty_key) {
+                        canvas.image->draw_slice(_pieces[spill].get(),
+                                                 x,
+                                                 y,
+                                                 cell_size - _offsets[spill],
+                                                 border);
+                    }
+                }
+            }
+
+            spill = empty_key;
+            if (piece != empty_key &&
+                _offsets[piece] + _pieces[piece]->width > cell_size) {
+                spill = piece;
+            }
+        }
+    }
+}
+
+void BoardRenderer::annotate(Canvas &canvas,
+                             const std::vector<Annotation> &annotations,
+                             Orientation orientation) {
+    for (const Annotation &annotation : annotations) {
+        int from_row = 7 - annotation.from / 8;
+        int from_col = annotation.from % 8;
+        int to_row = 7 - annotation.to / 8;
+        int to_col = annotation.to % 8;
+        if (orientation == Orientation::Black) {
+            from_row = 7 - from_row;
+            from_col = 7 - from_col;
+            to_row = 7 - to_row;
+            to_col = 7 - to_col;
+        }
+        Point from = {border + (from_col + 0.5) * cell_size,
+                      border + (from_row + 0.5) * cell_size};
+        Point to = {border + (to_col + 0.5) * cell_size,
+                    border + (to_row + 0.5) * cell_size};
+        if (annotation.from == annotation.to) {
+            canvas.image->draw_ring(from,
+                                    cell_size / 2 - 4,
+                                    cell_size / 12,
+                                    annotation.color);
+        } else {
+            canvas.image->draw_arrow(from,
+                                     to,
+                                     cell_size / 5,
+                                     annotation.color);
+        }
+
+        // Squares under the annotation must be redrawn on the next render
+        for (int row = std::min(from_row, to_row);
+             row <= std::max(from_row, to_row);
+             row++) {
+            for (int col = std::min(from_col, to_col);
+                 col <= std::max(from_col, to_col);
+                 col++) {
+                canvas.keys[row * 9 + col] = -1;
+            }
+        }
+    }
+}
+
+void BoardRenderer::draw_sidebar(Canvas &canvas,
+                                 const SearchSummary *summary,
+                                 Orientation orientation) {
+    if (!summary && !canvas.sidebar) return;
+    canvas.sidebar = summary;
+
+    // The margins are never touched by cells, so clear them wholesale
+    Image &image = *canvas.image;
+    for (int y = border; y < border + 8 * cell_size; y++) {
+        image.blit(_margin_row.get(), 0, y);
+    }
+    for (int y = border + 8 * cell_size; y < size; y++) {
+        image.blit(_footer_row.get(), 0, y);
+    }
+    if (!summary) return;
+
+    // Expected score of White, the light share of the bar
+    double score = 1 / (1 + std::pow(10, -summary->eval / 400.0));
+    int height = 8 * cell_size;
+    int light = std::lround(score * height);
+    for (int i = 0; i < height; i++) {
+        // White's share grows from the side White is sitting on
+        bool is_light = i >= height - light;
+        if (orientation == Orientation::Black) {
+            is_light = i < light;
+        }
+        image.blit(_bar_rows[!is_light].get(), bar_x, border + i);
+    }
+
+    std::string text = format_eval(summary->eval);
+    char buffer[32];
+    if (summary->depth) {
+        text += "  DEPTH " + std::to_string(summary->depth);
+    }
+    if (summary->nodes && summary->seconds > 0) {
+        double nps = summary->nodes / summary->seconds;
+        if (nps >= 1e6) {
+            std::snprintf(buffer, sizeof(buffer), "%.1fM", nps / 1e6);
+        } else {
+            std::snprintf(buffer, sizeof(buffer), "%.0fK", nps / 1e3);
+        }
+        text += "  " + std::string(buffer) + " NPS";
+    }
+
+    int x = border;
+    int y = border + 8 * cell_size +
+            (border - glyph_height * glyph_scale) / 2;
+    int advance = (glyph_width + 1) * glyph_scale;
+    for (char c : text) {
+        if (x + advance > size - border) break;
+        image.blit(get_glyph(c), x, y);
+        x += advance;
+    }
+}
+
+std::string BoardRenderer::render(uint64_t game_id,
+                                  brainiac::Board &board,
+                                  Orientation orientation,
+                                  const std::vector<Annotation> &annotations,
+                                  const SearchSummary *summary) {
+    _pending++;
+    std::shared_ptr<Canvas> canvas = get_canvas(game_id, orientation);
+    std::unique_lock<std::mutex> lock(canvas->mutex);
+    update(*canvas, board, orientation);
+    annotate(*canvas, annotations, orientation);
+    draw_sidebar(*canvas, summary, orientation);
+    std::string png = canvas->image->encode();
+    lock.unlock();
+    _pending--;
+    return png;
+}
+
+void BoardRenderer::release(uint64_t game_id) {
+    std::lock_guard<std::mutex> lock(_canvases_mutex);
+    for (Orientation orientation : {Orientation::White, Orientation::Black}) {
+        auto it = _canvases.find(game_id * 2 +
+                                 static_cast<uint64_t>(orientation));
+        if (it == _canvases.end()) continue;
+        _used.erase(it->second.used);
+        _canvases.erase(it);
+    }
+}
+
+bool BoardRenderer::saturated() { return _pending >= max_pending; }
+
+std::string format_eval(int eval) {
+    std::string sign = eval < 0 ? "-" : "+";
+    int magnitude = std::abs(eval);
+    if (magnitude > mate_score - max_ply) {
+        return "#" + sign + std::to_string((mate_score - magnitude + 1) / 2);
+    }
+    if (magnitude > tablebase_win - max_ply) {
+        return eval > 0 ? "1-0" : "0-1";
+    }
+    char pawns[16];
+    std::snprintf(pawns, sizeof(pawns), "%.2f", magnitude / 100.0);
+    return sign + pawns;
+}
+
+void generate_image(brainiac::Board &board,
+                    std::string filename,
+                    Orientation orientation) {
+    BoardRenderer renderer;
+    std::string png = renderer.render(0, board, orientation);
+    FILE *file = std::fopen(filename.c_str(), "wb");
+    if (file) {
+        std::fwrite(png.data(), 1, png.size(), file);
+        std::fclose(file);
+    }
+}
+
+/**
+ * Index of a piece type in the text symbol tables
+ */
+int symbol_index(brainiac::PieceType type) {
+    switch (type) {
+    case brainiac::PieceType::Pawn:
+        return 0;
+    case brainiac::PieceType::Knight:
+        return 1;
+    case brainiac::PieceType::Bishop:
+        return 2;
+    case brainiac::PieceType::Rook:
+        return 3;
+    case brainiac::PieceType::Queen:
+        return 4;
+    default:
+        return 5;
+    }
+}
+
+std::string generate_text(brainiac::Board &board,
+                          Orientation orientation,
+                          bool unicode) {
+    // Symbols indexed by color then piece type
+    const char *symbols[2][6] = {
+        {"\u2659", "\u2658", "\u2657", "\u2656", "\u2655", "\u2654"},
+        {"\u265F", "\u265E", "\u265D", "\u265C", "\u265B", "\u265A"},
+    };
+    const char *letters[2][6] = {
+        {"P", "N", "B", "R", "Q", "K"},
+        {"p", "n", "b", "r", "q", "k"},
+    };
+    const char *(&table)[2][6] = unicode ? symbols : letters;
+
+    std::string text;
+    for (int row = 0; row < 8; row++) {
+        int rank = orientation == Orientation::White ? 7 - row : row;
+        text += std::to_string(rank + 1);
+        for (int col = 0; col < 8; col++) {
+            int file = orientation == Orientation::White ? col : 7 - col;
+            brainiac::Piece piece = board.get_at_coords(rank, file);
+            text += ' ';
+            if (piece.is_empty()) {
+                text += unicode ? "\u00B7" : ".";
+            } else {
+                int color = piece.get_color() == brainiac::Color::White ? 0 : 1;
+                text += table[color][symbol_index(piece.get_type())];
+            }
+        }
+        text += '\n';
+    }
+    text += ' ';
+    for (int col = 0; col < 8; col++) {
+        int file = orientation == Orientation::White ? col : 7 - col;
+        text += ' ';
+        text += static_cast<char>('a' + file);
+    }
+    return text;
+}
@@ -0,0 +1,192 @@
+#ifndef RENDER_H_
+#define RENDER_H_
+
+#include <array>
+#include <atomic>
+#include <brainiac.h>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "font.h"
+#include "image.h"
+
+/**
+ * Which side of the board is drawn at the bottom of the image
+ */
+enum class Orientation { White, Black };
+
+/**
+ * Marking drawn over the board, an arrow between two squares or a circle
+ * around a square if both are the same
+ */
+struct Annotation {
+    brainiac::Square from;
+    brainiac::Square to;
+    Color color = {0.15, 0.6, 0.25, 0.8};
+};
+
+/**
+ * Engine statistics shown in the sidebar of a board, fields that are zero are
+ * left out
+ */
+struct SearchSummary {
+    // Centipawns from White's perspective
+    int eval = 0;
+    int depth = 0;
+    uint64_t nodes = 0;
+    double seconds = 0;
+};
+
+/**
+ * Renders boards onto cached canvases
+ *
+ * Each square is drawn by copying a pre-composited cell (tile + piece) into
+ * the canvas. A canvas is kept per game and orientation, and only squares
+ * whose contents changed since its last render are redrawn. Canvases are
+ * capped in number, the least recently rendered is dropped first and redrawn
+ * in full if needed again.
+ */
+class BoardRenderer {
+    /**
+     * Rendered board along with the cell keys that are currently drawn on it
+     *
+     * Keys are stored per screen position, column 8 being the right border
+     * that wide pieces on the last column can spill over.
+     */
+    struct Canvas {
+        std::unique_ptr<Image> image;
+        std::array<int, 8 * 9> keys;
+        bool sidebar = false;
+        std::mutex mutex;
+    };
+
+    std::string _image_dir;
+    std::array<std::unique_ptr<Image>, 2> _tiles;
+    std::array<std::unique_ptr<Image>, 12> _pieces;
+    std::array<std::atomic<int>, 12> _offsets;
+
+    // Tiles with a piece composited on top, index is tile * 13 + piece
+    std::array<std::unique_ptr<Image>, 2 * 13> _cells;
+    std::array<std::unique_ptr<Image>, 128> _glyphs;
+    std::mutex _cells_mutex;
+
+    // Single rows of the sidebar that are copied to build it
+    std::unique_ptr<Image> _footer_row;
+    std::unique_ptr<Image> _margin_row;
+    std::array<std::unique_ptr<Image>, 2> _bar_rows;
+
+    /**
+     * Canvas along with its position in the recency list
+     *
+     * Canvases are shared so one dropped while it renders stays alive until
+     * the render is done.
+     */
+    struct CanvasEntry {
+        std::shared_ptr<Canvas> canvas;
+        std::list<uint64_t>::iterator used;
+    };
+
+    std::unordered_map<uint64_t, CanvasEntry> _canvases;
+
+    // Canvas keys from most to least recently rendered
+    std::list<uint64_t> _used;
+    size_t _max_canvases;
+    std::mutex _canvases_mutex;
+
+    // Number of renders currently in progress
+    std::atomic<int> _pending = 0;
+
+    /**
+     * Get the pre-composited cell of a tile and piece (12 for none)
+     */
+    Image *get_cell(int tile, int piece);
+
+    /**
+     * Get the pre-rendered image of a character
+     */
+    Image *get_glyph(char c);
+
+    /**
+     * Get the canvas of a game in an orientation, creating it if necessary
+     */
+    std::shared_ptr<Canvas> get_canvas(uint64_t game_id, Orientation orientation);
+
+    /**
+     * Redraw the squares of a canvas that changed
+     */
+    void update(Canvas &canvas,
+                brainiac::Board &board,
+                Orientation orientation);
+
+    /**
+     * Draw annotations over a canvas and mark the squares they cover as dirty
+     */
+    void annotate(Canvas &canvas,
+                  const std::vector<Annotation> &annotations,
+                  Orientation orientation);
+
+    /**
+     * Draw the evaluation bar and search summary into the border of a canvas,
+     * or clear them if there is no summary
+     */
+    void draw_sidebar(Canvas &canvas,
+                      const SearchSummary *summary,
+                      Orientation orientation);
+
+  public:
+    static constexpr int cell_size = 128;
+    static constexpr int border = 32;
+    static constexpr int size = 2 * border + 8 * cell_size;
+
+    // Renders in progress past which the renderer is considered saturated
+    static constexpr int max_pending = 4;
+
+    BoardRenderer(std::string image_dir = "../images/",
+                  size_t max_canvases = 32);
+
+    /**
+     * Render the board of a game and encode it as a png
+     */
+    std::string render(uint64_t game_id,
+                       brainiac::Board &board,
+                       Orientation orientation = Orientation::White,
+                       const std::vector<Annotation> &annotations = {},
+                       const SearchSummary *summary = nullptr);
+
+    /**
+     * Release the canvases of a game
+     */
+    void release(uint64_t game_id);
+
+    /**
+     * Test if so many renders are in progress that callers should fall back
+     * to a cheaper output
+     */
+    bool saturated();
+};
+
+/**
+ * Format White's evaluation in pawns, the moves to a forced mate as #+3 or
+ * #-3, or a tablebase win as the result of the game
+ */
+std::string format_eval(int eval);
+
+/**
+ * Draw the board as text, using the Unicode chess symbols or plain letters
+ */
+std::string generate_text(brainiac::Board &board,
+                          Orientation orientation = Orientation::White,
+                          bool unicode = true);
+
+/**
+ * Generate a PNG image of the board and save it to disk
+ */
+void generate_image(brainiac::Board &board,
+                    std::string filename,
+                    Orientation orientation = Orientation::White);
+
+#endif
@@ -1,59 +1,151 @@
 #include "server.h"
 
-void generate_image(brainiac::Board &board, std::string filename) {
-    Image *base = new Image(64 + 128 * 8, 64 + 128 * 8);
-    base->fill({0.08, 0.08, 0.08, 1.0});
-
-    std::vector<Image *> pieces;
-    for (int i = 0; i < 12; i++) {
-        pieces.push_back(new Image("../images/" + std::to_string(i) + ".png"));
-    }
-    std::vector<Image *> tiles;
-    tiles.push_back(new Image("../images/brown0.png"));
-    tiles.push_back(new Image("../images/brown1.png"));
-
-    bool square_white = true;
-    for (int rank = 0; rank < 8; rank++) {
-        bool current_color = square_white;
-        for (int file = 0; file < 8; file++) {
-            // Render appropriate squares
-            Image *tile = tiles[current_color];
-            base->draw(tile, file * tile->width + 32, rank * tile->height + 32);
-            current_color = !current_color;
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <ctime>
+
+/**
+ * Search budgets of the difficulty levels below the strongest
+ */
+struct Level {
+    int depth;
+    uint64_t nodes;
+    std::chrono::milliseconds time;
+    int noise;
+};
+
+constexpr Level levels[max_level - 1] = {
+    {1, 200, std::chrono::milliseconds(50), 200},
+    {2, 1000, std::chrono::milliseconds(100), 120},
+    {3, 5000, std::chrono::milliseconds(200), 80},
+    {4, 20000, std::chrono::milliseconds(500), 40},
+    {5, 80000, std::chrono::milliseconds(1000), 20},
+    {6, 300000, std::chrono::milliseconds(2000), 10},
+    {8, 1000000, std::chrono::milliseconds(3000), 0},
+};
+
+/**
+ * Most candidate moves listed in reply to an invalid move, and most moves
+ * suggested while typing one, which Discord caps at 25
+ */
+constexpr int max_candidates = 12;
+constexpr int max_suggestions = 25;
+
+/**
+ * Most lines an analysis searches
+ */
+constexpr int max_analysis_lines = 5;
+
+/**
+ * Seconds between reports of the search queue
+ */
+constexpr uint64_t queue_report_interval = 60;
+
+/**
+ * Format a score from the perspective of the side to move as White's
+ * evaluation in pawns, or the moves to a forced mate
+ */
+std::string format_score(brainiac::Board &board, int score) {
+    return format_eval(board.get_turn() == brainiac::Color::White ? score
+                                                                  : -score);
+}
+
+/**
+ * Format the lines of an analysis of a position
+ */
+std::string analysis_text(brainiac::Board &board,
+                          const SearchResult &result,
+                          bool done) {
+    std::vector<SearchLine> lines = result.lines;
+    if (lines.empty() && !result.move.is_invalid()) {
+        lines.push_back({result.score, result.pv});
+        if (lines[0].pv.empty()) {
+            lines[0].pv.push_back(result.move);
         }
-        square_white = !square_white;
     }
-    for (int rank = 7; rank >= 0; rank--) {
-        for (int file = 0; file < 8; file++) {
-            // Render a the piece on top (if any)
-            brainiac::Piece piece = board.get_at_coords(rank, file);
-            if (piece.is_empty()) {
-                continue;
-            }
-            Image *piece_image = pieces[piece.get_index()];
 
-            int x_offset = 0;
-            if (piece.get_type() == brainiac::PieceType::Pawn ||
-                piece.get_type() == brainiac::PieceType::Knight ||
-                piece.get_type() == brainiac::PieceType::Rook) {
-                x_offset = 10;
-            }
-            base->draw(piece_image,
-                       (file * tiles[0]->width) + x_offset + 32,
-                       ((7 - rank) * tiles[0]->height + 32));
+    std::string text = "**Analysis** at depth " +
+                       std::to_string(result.depth) +
+                       (done ? "" : ", searching deeper...") + "\n";
+    MoveIndex index;
+    for (int i = 0; i < lines.size(); i++) {
+        text += std::to_string(i + 1) + ". `" +
+                format_score(board, lines[i].score) + "`";
+        brainiac::Board line = board;
+        for (brainiac::Move &move : lines[i].pv) {
+            index.update(line);
+            text += " " + index.san(line, move);
+            line.make_move(move);
         }
+        text += "\n";
     }
-    base->save(filename);
-    for (auto piece : pieces) {
-        delete piece;
+    return text;
+}
+
+/**
+ * Write the record of a game in PGN
+ */
+std::string game_pgn(Game &game, std::string result) {
+    auto tag = [](std::string name, std::string value) {
+        std::string escaped;
+        for (char c : value) {
+            if (c == '"' || c == '\\') {
+                escaped += '\\';
+            }
+            escaped += c;
+        }
+        return "[" + name + " \"" + escaped + "\"]\n";
+    };
+    // Records are written from event and search threads at once, so the
+    // time is broken down into a buffer of our own
+    std::tm started;
+    gmtime_r(&game.started, &started);
+    char date[16];
+    std::strftime(date, sizeof(date), "%Y.%m.%d", &started);
+    std::string text = tag("Event", "ChessAI game") + tag("Site", "Discord") +
+                       tag("Date", date) + tag("Round", "-") +
+                       tag("White", game.white.username) +
+                       tag("Black", game.black.username) +
+                       tag("Result", result) + "\n";
+
+    // Movetext is wrapped to lines of at most 79 characters
+    std::vector<std::string> tokens;
+    for (int i = 0; i < game.record.size(); i++) {
+        if (i % 2 == 0) {
+            tokens.push_back(std::to_string(i / 2 + 1) + ".");
+        }
+        tokens.push_back(game.record[i]);
     }
-    for (auto tile : tiles) {
-        delete tile;
+    tokens.push_back(result);
+    std::string line;
+    for (std::string &token : tokens) {
+        if (line.size() && line.size() + token.size() + 1 > 79) {
+            text += line + "\n";
+            line.clear();
+        }
+        line += (line.empty() ? "" : " ") + token;
     }
-    delete base;
+    return text + line + "\n";
 }
 
-ChessServer::ChessServer(dpp::cluster &bot) : _client(bot) {
+ChessServer::ChessServer(dpp::cluster &bot, ServerConfig config) :
+    _client(bot), _renderer("../images/", config.board_canvases),
+    _table(config.table_size, config.huge_pages),
+    _tablebase(config.syzygy_path, config.syzygy_pieces),
+    _pool(_table, &_tablebase, config.engine_memory), _cores(config.cores),
+    _local(_pool, _cores), _book(config.book_path, config.book_randoms),
+    _analyses(config.analysis_cache), _hints(config.hint_cache),
+    _config(config), _engines(config.search_workers, config.scheduler) {
+    if (config.engine_command.size()) {
+        _remote = std::make_unique<UciBackend>(config.engine_command,
+                                               config.engine_processes);
+    }
+    std::cout << "Transposition table: " << (_table.memory() >> 20)
+              << " MB on " << (_table.page_size() >> 10) << " KB pages\n";
+    std::cout << "Opening book: " << _book.size() << " entries\n";
+    std::cout << "Tablebases: up to " << _tablebase.pieces() << " pieces\n";
+
     bot.on_interaction_create([&bot,
                                this](const dpp::interaction_create_t &event) {
         std::string command = event.command.get_command_name();
@@ -70,17 +162,49 @@ ChessServer::ChessServer(dpp::cluster &bot) : _client(bot) {
             if (std::holds_alternative<std::string>(color_param)) {
                 color = std::get<std::string>(color_param);
             }
-            on_play(event, opponent, color);
+            const dpp::command_value &level_param =
+                event.get_parameter("level");
+            int level = max_level;
+            if (std::holds_alternative<int64_t>(level_param)) {
+                level = std::get<int64_t>(level_param);
+            }
+            on_play(event, opponent, color, level);
+        } else if (command == "simul") {
+            const dpp::command_value &level_param =
+                event.get_parameter("level");
+            int level = max_level;
+            if (std::holds_alternative<int64_t>(level_param)) {
+                level = std::get<int64_t>(level_param);
+            }
+            on_simul(event, level);
         } else if (command == "move") {
             const dpp::command_value &move_param = event.get_parameter("move");
             std::string move = std::get<std::string>(move_param);
             on_move(event, move);
         } else if (command == "board") {
             on_board(event);
+        } else if (command == "display") {
+            const dpp::command_value &mode_param = event.get_parameter("mode");
+            std::string mode = std::get<std::string>(mode_param);
+            on_display(event, mode);
+        } else if (command == "analyze") {
+            const dpp::command_value &lines_param =
+                event.get_parameter("lines");
+            int lines = 3;
+            if (std::holds_alternative<int64_t>(lines_param)) {
+                lines = std::get<int64_t>(lines_param);
+            }
+            on_analyze(event, lines);
+        } else if (command == "hint") {
+            on_hint(event);
         } else if (command == "resign") {
             on_resign(event);
         }
     });
+    bot.on_autocomplete(
+        [this](const dpp::autocomplete_t &event) { on_autocomplete(event); });
+    bot.start_timer([this](dpp::timer) { report_queue(); },
+                    queue_report_interval);
 };
 
 std::string ChessServer::hash_user(dpp::user user) {
@@ -89,15 +213,28 @@ std::string ChessServer::hash_user(dpp::user user) {
 
 dpp::message ChessServer::game_info(const dpp::interaction_create_t &event,
                                     Game &game,
-                                    std::string message) {
-    std::string image_filename =
-        "../boards/" + std::to_string(game.id) + ".png";
-    generate_image(game.board, image_filename);
+                                    std::string message,
+                                    std::vector<Annotation> annotations,
+                                    const SearchSummary *summary) {
+    Orientation orientation = Orientation::White;
+    if (event.command.usr.id == game.black.id &&
+        game.white.id != game.black.id) {
+        orientation = Orientation::Black;
+    }
 
-    dpp::message msg(event.command.channel_id, message);
-    msg.set_file_content(dpp::utility::read_file(image_filename));
-    msg.set_filename("board.png");
+    DisplayMode mode = DisplayMode::Image;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto mode_it = _display_modes.find(event.command.guild_id);
+        if (mode_it != _display_modes.end()) {
+            mode = mode_it->second;
+        }
+    }
+    if (mode == DisplayMode::Image && _renderer.saturated()) {
+        mode = DisplayMode::Unicode;
+    }
 
+    dpp::message msg(event.command.channel_id, message);
     dpp::embed embed =
         dpp::embed()
             .set_color(dpp::colors::blue)
@@ -106,50 +243,297 @@ dpp::message ChessServer::game_info(const dpp::interaction_create_t &event,
                         "https://keithleonardo.ml",
                         "https://avatars.githubusercontent.com/u/10874047")
             .set_description("Match information")
-            .add_field("FEN", game.board.generate_fen())
-            .set_image("attachment://board.png");
+            .add_field("FEN", game.board.generate_fen());
+
+    if (mode == DisplayMode::Image) {
+        msg.set_file_content(_renderer.render(game.id,
+                                              game.board,
+                                              orientation,
+                                              annotations,
+                                              summary));
+        msg.set_filename("board.png");
+        embed.set_image("attachment://board.png");
+    } else {
+        std::string board =
+            generate_text(game.board,
+                          orientation,
+                          mode == DisplayMode::Unicode);
+        embed.set_description("```\n" + board + "\n```");
+        if (summary) {
+            embed.add_field("Evaluation", format_eval(summary->eval));
+        }
+    }
 
     msg.add_embed(embed);
     return msg;
 }
 
-void ChessServer::delete_game(dpp::user user) {
-    std::string hash = hash_user(user);
-    uint64_t game_id = _users[hash];
-    Game &game = *_games[game_id];
+std::shared_ptr<Game> ChessServer::find_game(dpp::user user) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto user_it = _users.find(hash_user(user));
+    if (user_it == _users.end()) {
+        return nullptr;
+    }
+    return _games[user_it->second];
+}
 
+void ChessServer::delete_game(Game &game) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    game.active = false;
+    game.cancelled = true;
+    if (game.ponder) {
+        game.ponder->stop = true;
+    }
     _users.erase(hash_user(game.white));
     _users.erase(hash_user(game.black));
+    if (game.simul && game.simul->leave(game.id) == 0) {
+        _simuls.erase(game.simul->channel);
+    }
 
     // Reuse the id if possible
-    _games.erase(game_id);
-    _id_generator.unregister_id(game_id);
+    _renderer.release(game.id);
+    _local.release(game.id);
+    if (_remote) {
+        _remote->release(game.id);
+    }
+    _games.erase(game.id);
+    _id_generator.unregister_id(game.id);
+}
+
+SearchLimits ChessServer::search_limits(Game &game) {
+    SearchLimits limits;
+    limits.depth = _config.search_depth;
+    limits.nodes = _config.search_nodes;
+    limits.time = _config.search_time;
+    limits.threads = _config.search_threads;
+
+    // Searches give up part of their budget while others wait for a worker
+    double scale = _engines.budget_scale();
+    limits.nodes *= scale;
+    limits.time = std::chrono::duration_cast<std::chrono::milliseconds>(
+        limits.time * scale);
+    if (game.level >= max_level) return limits;
+
+    // Levels only ever tighten the server's budgets
+    const Level &level = levels[std::max(game.level, 1) - 1];
+    limits.depth = std::min(limits.depth, level.depth);
+    uint64_t level_nodes = level.nodes * scale;
+    if (limits.nodes == 0 || level_nodes < limits.nodes) {
+        limits.nodes = level_nodes;
+    }
+    auto level_time =
+        std::chrono::duration_cast<std::chrono::milliseconds>(level.time *
+                                                              scale);
+    if (limits.time.count() == 0 || level_time < limits.time) {
+        limits.time = level_time;
+    }
+    limits.threads = 1;
+    limits.noise = level.noise;
+    return limits;
+}
+
+Tenant ChessServer::tenant(Game &game) {
+    Tenant tenant;
+    tenant.guild = game.guild;
+    tenant.user = game.white.id == _client.me.id ? game.black.id
+                                                  : game.white.id;
+    return tenant;
+}
+
+SearchResult ChessServer::search(Game &game,
+                                 brainiac::Board board,
+                                 SearchLimits limits) {
+    if (_remote) {
+        SearchResult result = _remote->search(game.id, board, limits);
+        if (!result.move.is_invalid()) return result;
+    }
+    return _local.search(game.id, board, limits);
 }
 
 void ChessServer::bot_moves(const dpp::interaction_create_t &event,
-                            Game &game) {
-    brainiac::Move move = _bot.move(game.board);
-    game.board.make_move(move);
+                            std::shared_ptr<Game> game) {
+    std::shared_ptr<Ponder> ponder = std::move(game->ponder);
+    if (ponder) {
+        if (ponder->hash == game->board.get_hash()) {
+            // The expected reply was played, so the ponder search is the
+            // search of this move
+            if (ponder->done) {
+                post_move(event, game, ponder->result);
+                return;
+            }
+
+            // A ponder still waiting for a worker is no head start, and it
+            // stays on the game until posted so ending the game stops it
+            if (ponder->started) {
+                ponder->hit = true;
+                ponder->event = event;
+                game->ponder = ponder;
+                return;
+            }
+        }
+        ponder->stop = true;
+    }
+    search_move(event, game);
+}
+
+void ChessServer::search_move(const dpp::interaction_create_t &event,
+                              std::shared_ptr<Game> game) {
+    // Book moves skip the search entirely
+    brainiac::Move book_move = _book.probe(game->board);
+    if (!book_move.is_invalid()) {
+        SearchResult result;
+        result.move = book_move;
+        post_move(event, game, result);
+        return;
+    }
+
+    // Search a copy so the board stays readable while the bot thinks
+    brainiac::Board board = game->board;
+    if (game->simul) {
+        game->simul->queue(game->id, board);
+    }
+    _engines.submit(
+        [this, event, game, board]() {
+            SearchLimits limits = search_limits(*game);
+            limits.stop = &game->cancelled;
+            if (game->simul) {
+                auto share = game->simul->allocate(game->id);
+                if (limits.time.count() == 0 || share < limits.time) {
+                    limits.time = share;
+                }
+            }
+            SearchResult result = search(*game, board, limits);
+            if (game->simul) {
+                game->simul->done(game->id);
+            }
+
+            std::lock_guard<std::mutex> lock(game->mutex);
+            if (!game->active) return;
+            post_move(event, game, result);
+        },
+        tenant(*game));
+}
+
+void ChessServer::post_move(const dpp::interaction_create_t &event,
+                            std::shared_ptr<Game> game,
+                            const SearchResult &result) {
+    SearchSummary summary;
+    summary.eval = game->board.get_turn() == brainiac::Color::White
+                       ? result.score
+                       : -result.score;
+    summary.depth = result.depth;
+    summary.nodes = result.nodes;
+    summary.seconds = result.seconds;
+    game->moves.update(game->board);
+    std::string notation = game->moves.san(game->board, result.move);
+    game->record.push_back(notation);
+    game->board.make_move(result.move);
 
     dpp::user user;
-    if (event.command.usr.id == game.black.id) {
-        user = game.black;
+    if (event.command.usr.id == game->black.id) {
+        user = game->black;
     } else {
-        user = game.white;
+        user = game->white;
+    }
+    std::string message =
+        "<@" + std::to_string(user.id) + "> I move " + notation;
+    std::string outcome;
+    if (game->board.is_checkmate()) {
+        message += "\nCheckmate! <@" + std::to_string(_client.me.id) +
+                   "> wins! :robot:";
+        outcome = game->board.get_turn() == brainiac::Color::White ? "0-1"
+                                                                   : "1-0";
+    } else if (game->board.is_draw()) {
+        message += "\nIt's a draw! :handshake:";
+        outcome = "1/2-1/2";
     }
     _client.message_create(game_info(event,
-                                     game,
-                                     "<@" + std::to_string(user.id) +
-                                         "> I move " +
-                                         move.standard_notation()));
+                                     *game,
+                                     message,
+                                     {{result.move.get_from(),
+                                       result.move.get_to()}},
+                                     result.depth ? &summary : nullptr));
+    if (outcome.size()) {
+        post_record(event, *game, outcome);
+        delete_game(*game);
+        return;
+    }
+    ponder(game, result);
+}
+
+void ChessServer::post_record(const dpp::interaction_create_t &event,
+                              Game &game,
+                              std::string result) {
+    dpp::message msg(event.command.channel_id, "Game record");
+    msg.set_file_content(game_pgn(game, result));
+    msg.set_filename("game.pgn");
+    _client.message_create(msg);
+}
+
+void ChessServer::ponder(std::shared_ptr<Game> game,
+                         const SearchResult &result) {
+    if (!_config.ponder || result.pv.size() < 2) return;
+    if (_ponders.fetch_add(1) >= _config.max_ponders) {
+        _ponders--;
+        return;
+    }
+
+    brainiac::Board board = game->board;
+    board.make_move(result.pv[1]);
+    std::shared_ptr<Ponder> ponder = std::make_shared<Ponder>();
+    ponder->hash = board.get_hash();
+    game->ponder = ponder;
+
+    // Ponders are speculative, so they run in the background where they
+    // count against the workers kept free for bot moves and yield to them
+    _engines.submit_background(
+        [this, game, ponder, board](const std::atomic<bool> &yield) {
+            SearchResult result;
+            if (!ponder->stop) {
+                ponder->started = true;
+                SearchLimits limits = search_limits(*game);
+                limits.threads = 1;
+                limits.stop = &ponder->stop;
+                limits.yield = &yield;
+                result = search(*game, board, limits);
+            }
+            _ponders--;
+
+            std::lock_guard<std::mutex> lock(game->mutex);
+            if (ponder->stop || !game->active) return;
+
+            // A ponder that made way for waiting searches is dropped, and the
+            // move is searched afresh if its reply was already played
+            if (yield) {
+                ponder->stop = true;
+                if (game->ponder == ponder) {
+                    game->ponder = nullptr;
+                    if (ponder->hit) {
+                        search_move(*ponder->event, game);
+                    }
+                }
+                return;
+            }
+            ponder->done = true;
+            ponder->result = result;
+            if (ponder->hit) {
+                game->ponder = nullptr;
+                post_move(*ponder->event, game, result);
+            }
+        });
 }
 
 void ChessServer::on_play(const dpp::interaction_create_t &event,
                           dpp::user &opponent,
-                          std::string color) {
-    // Make sure both players are not in a game
+                          std::string color,
+                          int level) {
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    // Make sure both players are not in a game, the bot plays any number
+    bool bot = opponent.id == _client.me.id;
     if (_users.count(hash_user(event.command.usr)) ||
-        _users.count(hash_user(opponent))) {
+        (!bot && _users.count(hash_user(opponent)))) {
+        lock.unlock();
         event.reply("One of you is already in a game!");
         return;
     }
@@ -157,43 +541,84 @@ void ChessServer::on_play(const dpp::interaction_create_t &event,
     // Register a new game and assign its players
     uint64_t game_id = _id_generator.get_id();
     _users[hash_user(event.command.usr)] = game_id;
-    _users[hash_user(opponent)] = game_id;
+    if (!bot) {
+        _users[hash_user(opponent)] = game_id;
+    }
 
     // Assign each player a color (sender is white by default)
-    std::unique_ptr<Game> game_ptr;
+    std::shared_ptr<Game> game;
     if (color == "b") {
-        game_ptr = std::make_unique<Game>(opponent, event.command.usr);
+        game = std::make_shared<Game>(opponent, event.command.usr);
     } else {
-        game_ptr = std::make_unique<Game>(event.command.usr, opponent);
+        game = std::make_shared<Game>(event.command.usr, opponent);
     }
-    _games[game_id] = std::move(game_ptr);
-    Game &game = *_games[game_id];
-    game.id = game_id;
-    game.bot = opponent.id == _client.me.id;
+    _games[game_id] = game;
+    game->id = game_id;
+    game->guild = event.command.guild_id;
+    game->bot = bot;
+    game->level = std::clamp(level, 1, max_level);
+    lock.unlock();
 
-    event.reply(game_info(event, game));
+    std::lock_guard<std::mutex> game_lock(game->mutex);
+    event.reply(game_info(event, *game));
 
     // Handle bot making the first move
-    if (game.bot && game.white.id == _client.me.id) {
-        std::thread move(&ChessServer::bot_moves,
-                         std::ref(*this),
-                         std::ref(event),
-                         std::ref(game));
-        move.join();
+    if (game->bot && game->white.id == _client.me.id) {
+        bot_moves(event, game);
     }
 }
 
+void ChessServer::on_simul(const dpp::interaction_create_t &event,
+                           int level) {
+    std::unique_lock<std::mutex> lock(_mutex);
+    if (_users.count(hash_user(event.command.usr))) {
+        lock.unlock();
+        event.reply("You are already in a game!");
+        return;
+    }
+
+    // Join the channel's simul, the bot plays white on every board
+    std::shared_ptr<Simul> &simul = _simuls[event.command.channel_id];
+    if (!simul) {
+        simul = std::make_shared<Simul>(event.command.channel_id,
+                                        _config.simul_budget,
+                                        _config.simul_minimum);
+    }
+    uint64_t game_id = _id_generator.get_id();
+    _users[hash_user(event.command.usr)] = game_id;
+    std::shared_ptr<Game> game =
+        std::make_shared<Game>(_client.me, event.command.usr);
+    _games[game_id] = game;
+    game->id = game_id;
+    game->guild = event.command.guild_id;
+    game->bot = true;
+    game->level = std::clamp(level, 1, max_level);
+    game->simul = simul;
+    simul->join(game_id);
+    size_t boards = simul->size();
+    lock.unlock();
+
+    std::lock_guard<std::mutex> game_lock(game->mutex);
+    event.reply(game_info(event,
+                          *game,
+                          "<@" + std::to_string(event.command.usr.id) +
+                              "> joins the simul, " + std::to_string(boards) +
+                              " board" + (boards == 1 ? "" : "s") +
+                              " in play"));
+    bot_moves(event, game);
+}
+
 void ChessServer::on_move(const dpp::interaction_create_t &event,
                           std::string move_input) {
-    std::string player = hash_user(event.command.usr);
-    if (_users.find(player) == _users.end()) {
+    std::shared_ptr<Game> game_ptr = find_game(event.command.usr);
+    if (!game_ptr) {
         event.reply("You are not currently in a game.");
         return;
     }
 
     // Ensure that it's this player's turn
-    uint64_t game_id = _users[player];
-    Game &game = *_games[game_id];
+    std::lock_guard<std::mutex> lock(game_ptr->mutex);
+    Game &game = *game_ptr;
     if ((game.board.get_turn() == brainiac::Color::White &&
          event.command.usr.id != game.white.id) ||
         (game.board.get_turn() == brainiac::Color::Black &&
@@ -202,20 +627,14 @@ void ChessServer::on_move(const dpp::interaction_create_t &event,
         return;
     }
 
-    // Parse move input
-    std::string from = move_input.substr(0, 2);
-    std::string to = move_input.substr(2, 2);
-    char promotion = 0;
-    if (move_input.length() == 5) {
-        promotion = move_input[4];
-    }
-    brainiac::Move move =
-        game.board.create_move(brainiac::string_to_square(from),
-                               brainiac::string_to_square(to),
-                               promotion);
+    // Parse move input against the legal moves of the position
+    game.moves.update(game.board);
+    std::vector<brainiac::Move> candidates;
+    brainiac::Move move = game.moves.parse(move_input, candidates);
 
     // Execute the move
     if (!move.is_invalid()) {
+        game.record.push_back(game.moves.san(game.board, move));
         game.board.make_move(move);
 
         // Send messages based on board state
@@ -229,12 +648,18 @@ void ChessServer::on_move(const dpp::interaction_create_t &event,
                       "> wins! "
                       ":confetti_ball: :confetti_ball: :confetti_ball:";
             event.reply(game_info(event, game, message));
-            delete_game(event.command.usr);
+            post_record(event,
+                        game,
+                        game.board.get_turn() == brainiac::Color::White
+                            ? "0-1"
+                            : "1-0");
+            delete_game(game);
         } else if (game.board.is_draw()) {
             message =
                 "It's a draw! :confetti_ball: :confetti_ball: :confetti_ball:";
             event.reply(game_info(event, game, message));
-            delete_game(event.command.usr);
+            post_record(event, game, "1/2-1/2");
+            delete_game(game);
         } else {
             if (game.board.is_check()) {
                 message = "Check! Defend your king!";
@@ -242,46 +667,246 @@ void ChessServer::on_move(const dpp::interaction_create_t &event,
             event.reply(game_info(event, game));
             if (game.bot && event.command.usr.id != _client.me.id) {
                 // Handle bot response if it is the other player
-                std::thread response(&ChessServer::bot_moves,
-                                     std::ref(*this),
-                                     std::ref(event),
-                                     std::ref(game));
-                response.join();
+                bot_moves(event, game_ptr);
             }
         }
+    } else if (candidates.size()) {
+        std::string message = "Invalid move! Did you mean";
+        for (int i = 0; i < candidates.size() && i < max_candidates; i++) {
+            message += (i ? ", " : " ") +
+                       game.moves.san(game.board, candidates[i]);
+        }
+        if (candidates.size() > max_candidates) {
+            message += ", ...";
+        }
+        event.reply(message + "?");
     } else {
-        event.reply("Invalid move! :angry:");
+        event.reply("Invalid move! :angry: Moves are written in algebraic "
+                    "notation like Nf3, or as the squares they are played "
+                    "between like g1f3.");
+    }
+}
+
+void ChessServer::report_queue() {
+    int pending = _engines.pending();
+    uint64_t misses = _engines.slo_misses();
+    if (pending == 0 && misses == _reported_misses) return;
+    std::cout << "Search queue: " << pending << " waiting, "
+              << (misses - _reported_misses) << " waited past the "
+              << _config.scheduler.queue_slo.count() << " ms SLO in the last "
+              << queue_report_interval << " s\n";
+    _reported_misses = misses;
+}
+
+void ChessServer::on_autocomplete(const dpp::autocomplete_t &event) {
+    std::string typed;
+    for (const dpp::command_option &option : event.options) {
+        if (option.focused &&
+            std::holds_alternative<std::string>(option.value)) {
+            typed = std::get<std::string>(option.value);
+        }
+    }
+    std::transform(typed.begin(), typed.end(), typed.begin(), ::tolower);
+
+    dpp::interaction_response response(dpp::ir_autocomplete_reply);
+    std::shared_ptr<Game> game = find_game(event.command.usr);
+    if (game) {
+        std::lock_guard<std::mutex> lock(game->mutex);
+        game->moves.update(game->board);
+        int suggested = 0;
+        for (brainiac::Move move : game->moves.moves()) {
+            std::string notation = game->moves.san(game->board, move);
+            std::string lower = notation;
+            std::transform(lower.begin(),
+                           lower.end(),
+                           lower.begin(),
+                           ::tolower);
+            std::string coordinates = move.standard_notation();
+            if (lower.compare(0, typed.size(), typed) != 0 &&
+                coordinates.compare(0, typed.size(), typed) != 0) {
+                continue;
+            }
+            response.add_autocomplete_choice(
+                dpp::command_option_choice(notation, notation));
+            if (++suggested == max_suggestions) break;
+        }
     }
+    _client.interaction_response_create(event.command.id,
+                                        event.command.token,
+                                        response);
 }
 
 void ChessServer::on_board(const dpp::interaction_create_t &event) {
-    std::string player = hash_user(event.command.usr);
-    if (_users.count(player) == 0) {
+    std::shared_ptr<Game> game = find_game(event.command.usr);
+    if (!game) {
+        event.reply("You are not currently in a game.");
+        return;
+    }
+    std::lock_guard<std::mutex> lock(game->mutex);
+    event.reply(game_info(event, *game));
+}
+
+void ChessServer::on_display(const dpp::interaction_create_t &event,
+                             std::string mode) {
+    std::unique_lock<std::mutex> lock(_mutex);
+    if (mode == "unicode") {
+        _display_modes[event.command.guild_id] = DisplayMode::Unicode;
+    } else if (mode == "ascii") {
+        _display_modes[event.command.guild_id] = DisplayMode::Ascii;
+    } else {
+        _display_modes.erase(event.command.guild_id);
+        mode = "image";
+    }
+    lock.unlock();
+    event.reply("Boards in this server will be displayed as " + mode + ".");
+}
+
+void ChessServer::on_analyze(const dpp::interaction_create_t &event,
+                             int lines) {
+    std::shared_ptr<Game> game = find_game(event.command.usr);
+    if (!game) {
         event.reply("You are not currently in a game.");
         return;
     }
-    uint64_t game_id = _users[player];
-    Game &game = *_games[game_id];
-    event.reply(game_info(event, game));
+    std::unique_lock<std::mutex> lock(game->mutex);
+    brainiac::Board board = game->board;
+    lock.unlock();
+
+    // Analyses of the same position with as many lines are served from the
+    // cache
+    lines = std::clamp(lines, 1, max_analysis_lines);
+    uint64_t key = board.get_hash() ^ (lines * 0x9e3779b97f4a7c15ULL);
+    SearchResult cached;
+    if (_analyses.find(key, cached)) {
+        event.reply(analysis_text(board, cached, true));
+        return;
+    }
+    event.reply("Analyzing... :mag:");
+
+    Tenant tenant = {event.command.guild_id, event.command.usr.id};
+    _engines.submit(
+        [this, event, board, lines, key]() mutable {
+            SearchLimits limits;
+            limits.depth = _config.search_depth;
+            limits.time = std::chrono::duration_cast<std::chrono::milliseconds>(
+                _config.analysis_time * _engines.budget_scale());
+            limits.threads = _cores.acquire(_config.search_threads);
+            limits.lines = lines;
+
+            // Stream completed depths, at most one edit a second to stay
+            // within rate limits
+            auto edited = std::chrono::steady_clock::now();
+            limits.progress = [&](const SearchResult &result) {
+                auto now = std::chrono::steady_clock::now();
+                if (now - edited < std::chrono::seconds(1)) return;
+                edited = now;
+                event.edit_response(analysis_text(board, result, false));
+            };
+
+            // A separate engine on the shared table, so an analysis never
+            // waits on the game's engine while the bot is thinking
+            auto engine = std::make_unique<Engine>(_table, &_tablebase);
+            SearchResult result = engine->search(board, limits);
+            _cores.release(limits.threads);
+
+            _analyses.store(key, result);
+            event.edit_response(analysis_text(board, result, true));
+        },
+        tenant);
+}
+
+void ChessServer::on_hint(const dpp::interaction_create_t &event) {
+    std::shared_ptr<Game> game = find_game(event.command.usr);
+    if (!game) {
+        event.reply("You are not currently in a game.");
+        return;
+    }
+    std::unique_lock<std::mutex> lock(game->mutex);
+    dpp::snowflake turn = game->board.get_turn() == brainiac::Color::White
+                              ? game->white.id
+                              : game->black.id;
+    if (event.command.usr.id != turn) {
+        lock.unlock();
+        event.reply("Hints are only given on your turn.");
+        return;
+    }
+    brainiac::Board board = game->board;
+    uint64_t hash = board.get_hash();
+
+    // Repeated hints for a position are free
+    SearchResult cached;
+    if (_hints.find(hash, cached)) {
+        brainiac::Move move = cached.move;
+        game->moves.update(game->board);
+        event.reply(game_info(event,
+                              *game,
+                              "Hint: try " +
+                                  game->moves.san(game->board, move),
+                              {{move.get_from(), move.get_to()}}));
+        return;
+    }
+    lock.unlock();
+    event.reply("Looking for a hint... :thinking:");
+
+    _engines.submit_background(
+        [this, event, game, board, hash](const std::atomic<bool> &yield) {
+            SearchLimits limits;
+            limits.depth = _config.hint_depth;
+            limits.nodes = _config.hint_nodes;
+            limits.stop = &game->cancelled;
+            limits.yield = &yield;
+            auto engine = std::make_unique<Engine>(_table, &_tablebase);
+            SearchResult result = engine->search(board, limits);
+            if (game->cancelled) {
+                event.edit_response("The game ended before the hint was "
+                                    "ready.");
+                return;
+            }
+            if (result.move.is_invalid() || (yield && result.depth == 0)) {
+                event.edit_response("The bot is too busy for a hint right "
+                                    "now, try again in a moment.");
+                return;
+            }
+
+            // Hints cut short to make way for bot moves are not kept
+            if (!yield) {
+                _hints.store(hash, result);
+            }
+
+            std::lock_guard<std::mutex> lock(game->mutex);
+            if (!game->active || game->board.get_hash() != hash) {
+                event.edit_response("The position changed before the hint "
+                                    "was ready.");
+                return;
+            }
+            game->moves.update(game->board);
+            event.edit_response(game_info(
+                event,
+                *game,
+                "Hint: try " + game->moves.san(game->board, result.move),
+                {{result.move.get_from(), result.move.get_to()}}));
+        });
 }
 
 void ChessServer::on_resign(const dpp::interaction_create_t &event) {
-    std::string player = hash_user(event.command.usr);
-    if (_users.count(player) == 0) {
+    std::shared_ptr<Game> game = find_game(event.command.usr);
+    if (!game) {
         event.reply("You are not currently in a game.");
         return;
     }
-    uint64_t game_id = _users[player];
-    Game &game = *_games[game_id];
+    std::lock_guard<std::mutex> lock(game->mutex);
     dpp::user opponent;
-    if (event.command.usr.id == game.black.id) {
-        opponent = game.white;
+    if (event.command.usr.id == game->black.id) {
+        opponent = game->white;
     } else {
-        opponent = game.black;
+        opponent = game->black;
     }
     event.reply("<@" + std::to_string(event.command.usr.id) +
                 "> resigned :frowning2:\n"
                 "<@" +
                 std::to_string(opponent.id) + "> wins by default!");
-    delete_game(event.command.usr);
+    post_record(event,
+                *game,
+                opponent.id == game->white.id ? "1-0" : "0-1");
+    delete_game(*game);
 }
@@ -1,53 +1,227 @@
 #ifndef SERVER_H_
 #define SERVER_H_
 
+#include <atomic>
 #include <brainiac.h>
+#include <chrono>
+#include <ctime>
 #include <dpp/dpp.h>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <optional>
 #include <variant>
 
+#include "backend.h"
+#include "book.h"
+#include "cache.h"
+#include "engine.h"
 #include "id.h"
-#include "image.h"
+#include "moves.h"
+#include "pool.h"
+#include "render.h"
+#include "service.h"
+#include "simul.h"
+#include "table.h"
+#include "tablebase.h"
+#include "uci.h"
+
+/**
+ * Strongest difficulty level, which searches with the server's full budgets
+ */
+constexpr int max_level = 8;
+
+/**
+ * Search of the position expected after the opponent's reply, run while the
+ * opponent is still thinking
+ */
+struct Ponder {
+    // Hash of the position being searched
+    uint64_t hash;
+
+    // Set when the opponent plays something else or the game ends
+    std::atomic<bool> stop = false;
+
+    // Set once a worker picks the search up
+    std::atomic<bool> started = false;
+
+    // Set when the opponent plays the expected reply before the search is
+    // done, its result is then posted in answer to this event
+    bool hit = false;
+    std::optional<dpp::interaction_create_t> event;
+
+    bool done = false;
+    SearchResult result;
+};
 
 /**
  * Represents a single game
  */
 struct Game {
     uint64_t id;
+
+    // Guild the game was started in, zero in direct messages
+    uint64_t guild = 0;
     dpp::user white;
     dpp::user black;
     brainiac::Board board;
     bool bot = false;
 
+    // Legal moves of the board, indexed when first needed in a position
+    MoveIndex moves;
+
+    // Moves played in standard algebraic notation, and when the game began
+    std::vector<std::string> record;
+    std::time_t started = std::time(nullptr);
+
+    // Difficulty of the bot, from 1 up to max_level
+    int level = max_level;
+
+    // Cleared once the game is over, so late search results are dropped
+    bool active = true;
+
+    // Set once the game is over to stop any search still running for it
+    std::atomic<bool> cancelled = false;
+
+    // Search of the expected reply while the bot waits for it
+    std::shared_ptr<Ponder> ponder;
+
+    // Simul the game is a board of, if any
+    std::shared_ptr<Simul> simul;
+
+    // Guards the board, held while it is read or moved on
+    std::mutex mutex;
+
     Game(dpp::user _white, dpp::user _black) : white(_white), black(_black){};
 };
 
 /**
- * Generate a PNG image of the board and save it to disk
+ * Tunable parameters of the server
  */
-void generate_image(brainiac::Board &board, std::string filename);
+struct ServerConfig {
+    // Threads running searches, and how they are shared between guilds and
+    // users
+    int search_workers = 4;
+    SchedulerConfig scheduler;
+
+    // Memory budget of the engines kept for games, and the size of the
+    // transposition table they share, in bytes
+    size_t engine_memory = size_t(64) << 20;
+    size_t table_size = size_t(256) << 20;
+
+    // Back the transposition table with huge pages where available
+    bool huge_pages = true;
+
+    // Depth the bot searches to, and the nodes and time it may spend on a
+    // move, zero for no limit
+    int search_depth = 12;
+    uint64_t search_nodes = 0;
+    std::chrono::milliseconds search_time{5000};
+
+    // Threads each bot search may use, and the cores all searches may occupy
+    // at once, helper threads are only started while cores are free
+    int search_threads = 1;
+    int cores = 4;
+
+    // Polyglot opening book, and the text file of the standard Polyglot
+    // random values its keys are made of
+    std::string book_path = "book.bin";
+    std::string book_randoms = "polyglot_randoms.txt";
+
+    // Directories of Syzygy tables separated by colons, and the most pieces
+    // of the tables to use
+    std::string syzygy_path;
+    int syzygy_pieces = 6;
+
+    // Shell command running a UCI engine, searches run on this many of them
+    // instead of in process if set
+    std::string engine_command;
+    int engine_processes = 4;
+
+    // Search time of the bot shared by the boards of a simul waiting on its
+    // move, and the least time each of them gets
+    std::chrono::milliseconds simul_budget{20000};
+    std::chrono::milliseconds simul_minimum{100};
+
+    // Search the expected reply while the opponent thinks, with at most this
+    // many ponder searches at once across all games, which share the workers
+    // background jobs may take with hints
+    bool ponder = true;
+    int max_ponders = 2;
+
+    // Time an analysis may search for, and the analyses kept for positions
+    // users analyze again
+    std::chrono::milliseconds analysis_time{3000};
+    size_t analysis_cache = 1024;
+
+    // Depth and nodes of the cheap search behind a hint, and the hints kept
+    // for positions asked about again
+    int hint_depth = 4;
+    uint64_t hint_nodes = 20000;
+    size_t hint_cache = 4096;
+
+    // Board canvases kept between renders, each takes about 4.7 MB
+    size_t board_canvases = 32;
+};
+
+/**
+ * How boards are displayed in a guild
+ */
+enum class DisplayMode { Image, Unicode, Ascii };
 
 /**
  * Discord bot client running main game loop
  */
 class ChessServer {
-    std::unordered_map<uint64_t, std::unique_ptr<Game>> _games;
+    std::unordered_map<uint64_t, std::shared_ptr<Game>> _games;
     std::unordered_map<std::string, uint64_t> _users;
     IDGen _id_generator;
+    std::unordered_map<dpp::snowflake, DisplayMode> _display_modes;
+    std::unordered_map<dpp::snowflake, std::shared_ptr<Simul>> _simuls;
+
+    // Guards the maps above, taken after a game's mutex if both are needed
+    std::mutex _mutex;
 
     dpp::cluster &_client;
 
-    brainiac::Search _bot;
+    BoardRenderer _renderer;
+
+    TranspositionTable _table;
+    Tablebase _tablebase;
+    EnginePool _pool;
+    CoreBudget _cores;
+    LocalBackend _local;
+    std::unique_ptr<EngineBackend> _remote;
+    OpeningBook _book;
+    std::atomic<int> _ponders = 0;
+    SearchCache _analyses;
+    SearchCache _hints;
+
+    ServerConfig _config;
+
+    // Queue SLO misses counted at the last report
+    uint64_t _reported_misses = 0;
+
+    // Declared last so its workers are joined before anything the jobs they
+    // run use is destroyed
+    EngineService _engines;
 
   public:
-    ChessServer(dpp::cluster &bot);
+    ChessServer(dpp::cluster &bot, ServerConfig config);
 
     /**
      * Send an embed containing information about a game
+     *
+     * The board is drawn from the perspective of the user who triggered the
+     * event, with any annotations drawn on top and an optional search summary
+     * in its sidebar. Guilds that display boards as text, or a saturated
+     * renderer, get a text board instead of an image.
      */
     dpp::message game_info(const dpp::interaction_create_t &event,
                            Game &game,
-                           std::string message = "");
+                           std::string message = "",
+                           std::vector<Annotation> annotations = {},
+                           const SearchSummary *summary = nullptr);
 
     /**
      * Get the string hash of a user
@@ -55,14 +229,86 @@ class ChessServer {
     std::string hash_user(dpp::user user);
 
     /**
-     * Delete an active chess game
+     * Find the game a user is playing, if any
+     */
+    std::shared_ptr<Game> find_game(dpp::user user);
+
+    /**
+     * Log the searches waiting and those that waited past the queue SLO
+     * since the last report, if there are any
+     */
+    void report_queue();
+
+    /**
+     * Delete an active chess game, cancelling any search still running for it
+     *
+     * The caller must hold the game's mutex
+     */
+    void delete_game(Game &game);
+
+    /**
+     * Post the record of a game that is over as a PGN file, with its result
+     * written as 1-0, 0-1 or 1/2-1/2
+     */
+    void post_record(const dpp::interaction_create_t &event,
+                     Game &game,
+                     std::string result);
+
+    /**
+     * Get the limits of a bot search at the difficulty of a game
+     *
+     * Lower levels search less deep with smaller budgets and noisier
+     * evaluations, so they cost a fraction of a full search. Time and node
+     * budgets shrink while searches queue for a worker.
+     */
+    SearchLimits search_limits(Game &game);
+
+    /**
+     * Get the tenant searches of a game are scheduled for
      */
-    void delete_game(dpp::user user);
+    Tenant tenant(Game &game);
 
     /**
-     * Run chess bot on a separate thread
+     * Search a position of a game on the remote backend if there is one,
+     * falling back to searching in process if it fails
+     */
+    SearchResult search(Game &game,
+                        brainiac::Board board,
+                        SearchLimits limits);
+
+    /**
+     * Queue the bot's move on the search workers
+     *
+     * Returns immediately, the move is posted to the channel of the event once
+     * the search completes. If the bot was pondering the current position its
+     * result is used instead. The caller must hold the game's mutex.
+     */
+    void bot_moves(const dpp::interaction_create_t &event,
+                   std::shared_ptr<Game> game);
+
+    /**
+     * Play the bot's move from the book or queue a search for it
+     *
+     * The caller must hold the game's mutex.
+     */
+    void search_move(const dpp::interaction_create_t &event,
+                     std::shared_ptr<Game> game);
+
+    /**
+     * Play the move found by the bot and post it
+     *
+     * The caller must hold the game's mutex.
      */
-    void bot_moves(const dpp::interaction_create_t &event, Game &game);
+    void post_move(const dpp::interaction_create_t &event,
+                   std::shared_ptr<Game> game,
+                   const SearchResult &result);
+
+    /**
+     * Start searching the reply the bot expects after its move
+     *
+     * The caller must hold the game's mutex.
+     */
+    void ponder(std::shared_ptr<Game> game, const SearchResult &result);
 
     /**
      * Play command
@@ -71,7 +317,16 @@ class ChessServer {
      */
     void on_play(const dpp::interaction_create_t &event,
                  dpp::user &opponent,
-                 std::string color);
+                 std::string color,
+                 int level);
+
+    /**
+     * Simul command
+     *
+     * User joins the bot's simul in the channel, starting one if there is
+     * none
+     */
+    void on_simul(const dpp::interaction_create_t &event, int level);
 
     /**
      * Move command
@@ -81,6 +336,11 @@ class ChessServer {
     void on_move(const dpp::interaction_create_t &event,
                  std::string move_input);
 
+    /**
+     * Suggest legal moves starting with what the user has typed so far
+     */
+    void on_autocomplete(const dpp::autocomplete_t &event);
+
     /**
      * Board command
      *
@@ -88,6 +348,29 @@ class ChessServer {
      */
     void on_board(const dpp::interaction_create_t &event);
 
+    /**
+     * Display command
+     *
+     * User chooses how boards are displayed in the guild
+     */
+    void on_display(const dpp::interaction_create_t &event, std::string mode);
+
+    /**
+     * Analyze command
+     *
+     * User wants the best lines of their game's position, the reply is
+     * edited as the search deepens
+     */
+    void on_analyze(const dpp::interaction_create_t &event, int lines);
+
+    /**
+     * Hint command
+     *
+     * User wants a move suggested for their turn, searched at low priority
+     * so bot moves are never kept waiting
+     */
+    void on_hint(const dpp::interaction_create_t &event);
+
     /**
      * Resign command
      *
@@ -0,0 +1,242 @@
+#include "service.h"
+
+#include <algorithm>
+
+EngineService::EngineService(int workers, SchedulerConfig config) :
+    _config(config), _worker_count(std::max(workers, 1)) {
+    for (int i = 0; i < _worker_count; i++) {
+        _workers.emplace_back(&EngineService::work, this);
+    }
+}
+
+EngineService::~EngineService() {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stopping = true;
+    }
+    _available.notify_all();
+    for (std::thread &worker : _workers) {
+        worker.join();
+    }
+}
+
+int EngineService::weight(uint64_t guild) {
+    auto it = _config.weights.find(guild);
+    return it == _config.weights.end() ? 1 : std::max(it->second, 1);
+}
+
+bool EngineService::can_run(const Tenant &tenant) {
+    if (tenant.guild && _config.guild_limit &&
+        _guild_running[tenant.guild] >= _config.guild_limit) {
+        return false;
+    }
+    if (tenant.user && _config.user_limit &&
+        _user_running[tenant.user] >= _config.user_limit) {
+        return false;
+    }
+    return true;
+}
+
+EngineService::Queued EngineService::take(uint64_t guild_id,
+                                          uint64_t user_id) {
+    GuildQueue &guild = _guilds[guild_id];
+    std::deque<Queued> &jobs = guild.users[user_id];
+    Queued job = std::move(jobs.front());
+    jobs.pop_front();
+    _queued--;
+
+    if (jobs.empty()) {
+        guild.users.erase(user_id);
+        guild.turns.erase(
+            std::find(guild.turns.begin(), guild.turns.end(), user_id));
+    }
+    if (guild.users.empty()) {
+        _guilds.erase(guild_id);
+        auto turn = std::find(_turns.begin(), _turns.end(), guild_id);
+        bool front = turn == _turns.begin();
+        _turns.erase(turn);
+        if (front && !_turns.empty()) {
+            _credit = weight(_turns.front());
+        }
+    }
+
+    _guild_running[job.tenant.guild]++;
+    _user_running[job.tenant.user]++;
+    auto waited = std::chrono::steady_clock::now() - job.queued;
+    if (_config.queue_slo.count() && waited > _config.queue_slo) {
+        _slo_misses++;
+    }
+    return job;
+}
+
+bool EngineService::next(Queued &job) {
+    if (_turns.empty()) return false;
+
+    // Jobs waiting past the SLO go first, oldest first
+    if (_config.queue_slo.count()) {
+        auto late = std::chrono::steady_clock::now() - _config.queue_slo;
+        const Queued *oldest = nullptr;
+        for (auto &guild : _guilds) {
+            for (auto &user : guild.second.users) {
+                const Queued &head = user.second.front();
+                if (head.queued < late && can_run(head.tenant) &&
+                    (!oldest || head.queued < oldest->queued)) {
+                    oldest = &head;
+                }
+            }
+        }
+        if (oldest) {
+            Tenant tenant = oldest->tenant;
+            job = take(tenant.guild, tenant.user);
+            return true;
+        }
+    }
+
+    // Otherwise the guild whose turn it is runs its next user's job, guilds
+    // that cannot run lose their turn
+    for (size_t i = 0; i < _turns.size(); i++) {
+        uint64_t guild_id = _turns.front();
+        GuildQueue &guild = _guilds[guild_id];
+        for (uint64_t user_id : guild.turns) {
+            Tenant tenant = guild.users[user_id].front().tenant;
+            if (!can_run(tenant)) continue;
+
+            // Users take turns within the guild
+            guild.turns.erase(
+                std::find(guild.turns.begin(), guild.turns.end(), user_id));
+            guild.turns.push_back(user_id);
+            bool last = --_credit <= 0;
+            job = take(guild_id, user_id);
+            if (last && !_turns.empty() && _turns.front() == guild_id) {
+                _turns.pop_front();
+                _turns.push_back(guild_id);
+                _credit = weight(_turns.front());
+            }
+            return true;
+        }
+        _turns.pop_front();
+        _turns.push_back(guild_id);
+        _credit = weight(_turns.front());
+    }
+    return false;
+}
+
+bool EngineService::next_background(Queued &job) {
+    if (_background.empty()) return false;
+
+    // Every worker but one may run jobs of either kind, a single worker only
+    // takes a background job while it has nothing else to run
+    if (_running >= std::max(_worker_count - 1, 1)) return false;
+    job = std::move(_background.front());
+    _background.pop_front();
+    job.yield = std::make_shared<std::atomic<bool>>(false);
+    _yields.push_back(job.yield);
+    return true;
+}
+
+void EngineService::work() {
+    while (true) {
+        Queued job;
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _idle++;
+            _available.wait(lock, [&]() {
+                return _stopping || next(job) || next_background(job);
+            });
+            _idle--;
+            if (_stopping) return;
+            _running++;
+        }
+        if (job.background) {
+            job.background(*job.yield);
+        } else {
+            job.job();
+        }
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _running--;
+            if (job.background) {
+                _yields.erase(
+                    std::find(_yields.begin(), _yields.end(), job.yield));
+            } else {
+                if (--_guild_running[job.tenant.guild] == 0) {
+                    _guild_running.erase(job.tenant.guild);
+                }
+                if (--_user_running[job.tenant.user] == 0) {
+                    _user_running.erase(job.tenant.user);
+                }
+            }
+        }
+
+        // Finishing may let a tenant at its limit run again
+        _available.notify_all();
+    }
+}
+
+void EngineService::submit(SearchJob job, Tenant tenant) {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_turns.empty()) {
+            _credit = weight(tenant.guild);
+        }
+        if (!_guilds.count(tenant.guild)) {
+            _turns.push_back(tenant.guild);
+        }
+        GuildQueue &guild = _guilds[tenant.guild];
+        if (!guild.users.count(tenant.user)) {
+            guild.turns.push_back(tenant.user);
+        }
+        guild.users[tenant.user].push_back(
+            {std::move(job), tenant, std::chrono::steady_clock::now()});
+        _queued++;
+
+        // Background jobs make way once regular ones have to wait
+        if (_idle == 0) {
+            for (auto &yield : _yields) {
+                *yield = true;
+            }
+        }
+    }
+    _available.notify_one();
+}
+
+void EngineService::submit_background(BackgroundJob job) {
+    Queued queued;
+    queued.queued = std::chrono::steady_clock::now();
+    queued.background = std::move(job);
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _background.push_back(std::move(queued));
+    }
+    _available.notify_one();
+}
+
+int EngineService::pending() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _queued;
+}
+
+uint64_t EngineService::slo_misses() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _slo_misses;
+}
+
+double EngineService::budget_scale() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return std::max(0.25, _worker_count / double(_worker_count + _queued));
+}
+
+CoreBudget::CoreBudget(int cores) : _cores(std::max(cores, 1)) {}
+
+int CoreBudget::acquire(int count) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    int helpers = std::min(count - 1, _cores - _used - 1);
+    int granted = std::max(helpers, 0) + 1;
+    _used += granted;
+    return granted;
+}
+
+void CoreBudget::release(int count) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _used -= count;
+}
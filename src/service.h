@@ -0,0 +1,207 @@
+#ifndef SERVICE_H_
+#define SERVICE_H_
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * Unit of work run on a search worker
+ */
+using SearchJob = std::function<void()>;
+
+/**
+ * Low priority unit of work, handed a flag that is set once a regular job is
+ * waiting for a worker
+ */
+using BackgroundJob = std::function<void(const std::atomic<bool> &yield)>;
+
+/**
+ * Guild and user a job is run for, scheduled fairly against each other
+ */
+struct Tenant {
+    uint64_t guild = 0;
+    uint64_t user = 0;
+};
+
+/**
+ * Fair sharing of the search workers between tenants
+ */
+struct SchedulerConfig {
+    // Most jobs of a guild and of a user running at once, zero for no limit
+    int guild_limit = 0;
+    int user_limit = 0;
+
+    // Queue time after which a job runs ahead of its turn, zero for none
+    std::chrono::milliseconds queue_slo{0};
+
+    // Jobs a guild runs per round, guilds not listed get one
+    std::unordered_map<uint64_t, int> weights;
+};
+
+/**
+ * Fixed pool of search workers fed by a fair-share job queue
+ *
+ * Searches run off the event threads, so a slow search only occupies its own
+ * worker. Guilds take turns by weighted round-robin, and the users of a guild
+ * take turns within its share, so one guild starting many games cannot take
+ * every worker. A job waiting past the queue SLO runs next regardless of
+ * turns, unless its tenant is at its limit.
+ *
+ * Background jobs only take workers that leave one free for regular jobs,
+ * and are asked to yield when a regular job finds no idle worker. With a
+ * single worker they run while it is idle, and a regular job arriving then
+ * waits for the background job to yield.
+ */
+class EngineService {
+    struct Queued {
+        SearchJob job;
+        Tenant tenant;
+        std::chrono::steady_clock::time_point queued;
+
+        // Set for background jobs only
+        BackgroundJob background = nullptr;
+        std::shared_ptr<std::atomic<bool>> yield = nullptr;
+    };
+
+    struct GuildQueue {
+        std::unordered_map<uint64_t, std::deque<Queued>> users;
+
+        // Users with queued jobs, in turn order
+        std::deque<uint64_t> turns;
+    };
+
+    SchedulerConfig _config;
+    int _worker_count;
+
+    std::unordered_map<uint64_t, GuildQueue> _guilds;
+
+    // Jobs running for each guild and user
+    std::unordered_map<uint64_t, int> _guild_running;
+    std::unordered_map<uint64_t, int> _user_running;
+
+    // Guilds with queued jobs in turn order, and the jobs the guild at the
+    // front may still run this round
+    std::deque<uint64_t> _turns;
+    int _credit = 0;
+
+    int _queued = 0;
+    uint64_t _slo_misses = 0;
+
+    // Low priority jobs outside of the fair share, and the yield flags of
+    // those running
+    std::deque<Queued> _background;
+    std::vector<std::shared_ptr<std::atomic<bool>>> _yields;
+
+    // Jobs of either kind running, and workers waiting for a job
+    int _running = 0;
+    int _idle = 0;
+
+    std::vector<std::thread> _workers;
+    std::mutex _mutex;
+    std::condition_variable _available;
+    bool _stopping = false;
+
+    /**
+     * Get the number of jobs a guild runs per round
+     */
+    int weight(uint64_t guild);
+
+    /**
+     * Test if a tenant may start another job, tenants with no id are not
+     * limited
+     */
+    bool can_run(const Tenant &tenant);
+
+    /**
+     * Take the next job to run, returns false if no tenant may run one
+     */
+    bool next(Queued &job);
+
+    /**
+     * Take the next low priority job, returns false if none may run
+     */
+    bool next_background(Queued &job);
+
+    /**
+     * Take the first job of a user of a guild
+     */
+    Queued take(uint64_t guild, uint64_t user);
+
+    /**
+     * Main loop of a worker thread
+     */
+    void work();
+
+  public:
+    EngineService(int workers, SchedulerConfig config = {});
+    ~EngineService();
+
+    /**
+     * Queue a job to run on a free worker once it is the tenant's turn
+     */
+    void submit(SearchJob job, Tenant tenant = {});
+
+    /**
+     * Queue a low priority job, which only starts when no other job can and
+     * never takes the last free worker while there is more than one
+     *
+     * The job should wind down once its yield flag is set. Background jobs
+     * are not counted as pending, so they never shrink the budgets of other
+     * searches.
+     */
+    void submit_background(BackgroundJob job);
+
+    /**
+     * Get the number of jobs waiting for a worker
+     */
+    int pending();
+
+    /**
+     * Get the number of jobs that waited longer than the queue SLO
+     */
+    uint64_t slo_misses();
+
+    /**
+     * Get the fraction of their full budget searches should use given the
+     * jobs waiting, from 1 when the queue is empty down to a quarter
+     */
+    double budget_scale();
+};
+
+/**
+ * Number of cores searches may occupy at once
+ *
+ * A search always gets the core of the worker running it, helper threads are
+ * only granted while cores are free, so a single search can use the machine
+ * when load is low.
+ */
+class CoreBudget {
+    int _cores;
+    int _used = 0;
+    std::mutex _mutex;
+
+  public:
+    CoreBudget(int cores);
+
+    /**
+     * Reserve up to some number of cores, returns the number granted which is
+     * at least one
+     */
+    int acquire(int count);
+
+    /**
+     * Return cores granted by acquire
+     */
+    void release(int count);
+};
+
+#endif
@@ -0,0 +1,80 @@
+#include "simul.h"
+
+#include <algorithm>
+#include <vector>
+
+Simul::Simul(uint64_t channel,
+             std::chrono::milliseconds budget,
+             std::chrono::milliseconds minimum) :
+    _budget(budget), _minimum(minimum), channel(channel) {}
+
+void Simul::join(uint64_t game_id) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _boards[game_id];
+}
+
+size_t Simul::leave(uint64_t game_id) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _boards.erase(game_id);
+    return _boards.size();
+}
+
+void Simul::queue(uint64_t game_id, brainiac::Board &board) {
+    // Positions with more moves, captures or a check need more time
+    std::vector<brainiac::Move> moves = board.get_moves();
+    int captures = 0;
+    for (brainiac::Move &move : moves) {
+        int to = move.get_to();
+        if (!board.get_at_coords(to / 8, to % 8).is_empty()) {
+            captures++;
+        }
+    }
+    double complexity = 1 + moves.size() / 20.0 + captures / 5.0;
+    if (board.is_check()) {
+        complexity += 0.5;
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    Board &entry = _boards[game_id];
+    entry.waiting = true;
+    entry.queued = std::chrono::steady_clock::now();
+    entry.complexity = complexity;
+}
+
+std::chrono::milliseconds Simul::allocate(uint64_t game_id) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto now = std::chrono::steady_clock::now();
+
+    // Urgency grows by one for each second a player has waited
+    auto weight = [&](const Board &board) {
+        double waited =
+            std::chrono::duration<double>(now - board.queued).count();
+        return board.complexity * (1 + waited);
+    };
+    double total = 0;
+    for (auto &board : _boards) {
+        if (board.second.waiting) {
+            total += weight(board.second);
+        }
+    }
+
+    auto it = _boards.find(game_id);
+    if (it == _boards.end() || total == 0) return _budget;
+    double share = weight(it->second) / total;
+    std::chrono::milliseconds time(
+        static_cast<int64_t>(_budget.count() * share));
+    return std::clamp(time, _minimum, _budget);
+}
+
+void Simul::done(uint64_t game_id) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto it = _boards.find(game_id);
+    if (it != _boards.end()) {
+        it->second.waiting = false;
+    }
+}
+
+size_t Simul::size() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _boards.size();
+}
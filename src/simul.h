@@ -0,0 +1,74 @@
+#ifndef SIMUL_H_
+#define SIMUL_H_
+
+#include <brainiac.h>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+
+/**
+ * Simultaneous exhibition of the bot against many users in one channel
+ *
+ * The bot's thinking time is a single budget shared by every board waiting
+ * on its move. Each board gets a share weighted by how complex its position
+ * is and how long its player has been waiting, so many boards still move
+ * within seconds.
+ */
+class Simul {
+    struct Board {
+        bool waiting = false;
+        std::chrono::steady_clock::time_point queued;
+        double complexity = 1;
+    };
+
+    std::unordered_map<uint64_t, Board> _boards;
+
+    std::chrono::milliseconds _budget;
+    std::chrono::milliseconds _minimum;
+
+    std::mutex _mutex;
+
+  public:
+    const uint64_t channel;
+
+    /**
+     * Create a simul in a channel, with the time shared by the waiting
+     * boards and the least time any one of them gets
+     */
+    Simul(uint64_t channel,
+          std::chrono::milliseconds budget,
+          std::chrono::milliseconds minimum);
+
+    /**
+     * Add the board of a game
+     */
+    void join(uint64_t game_id);
+
+    /**
+     * Remove the board of a game that is over, returns the boards left
+     */
+    size_t leave(uint64_t game_id);
+
+    /**
+     * Mark a board as waiting on the bot's move in a position
+     */
+    void queue(uint64_t game_id, brainiac::Board &board);
+
+    /**
+     * Get the time a waiting board may search for as its search starts
+     */
+    std::chrono::milliseconds allocate(uint64_t game_id);
+
+    /**
+     * Mark a board as no longer waiting once the bot has moved
+     */
+    void done(uint64_t game_id);
+
+    /**
+     * Get the number of boards
+     */
+    size_t size();
+};
+
+#endif
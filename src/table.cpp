@@ -0,0 +1,210 @@
+#include "table.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstdio>
+#include <fstream>
+#include <new>
+#include <string>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+/**
+ * Slots of a bucket, which fill a cache line
+ */
+constexpr size_t bucket_slots = 4;
+
+/**
+ * Wall-clock time of a generation, an entry loses a ply of worth for each
+ */
+constexpr std::chrono::seconds epoch(8);
+
+/**
+ * Size of a huge page
+ */
+size_t huge_page_size() {
+    size_t size = 0;
+    std::ifstream file("/sys/kernel/mm/transparent_hugepage/hpage_pmd_size");
+    file >> size;
+    return size ? size : size_t(2) << 20;
+}
+
+/**
+ * Size of the pages backing an address, as reported by the kernel
+ *
+ * Transparent huge pages are only a hint, so the mapping is checked for any
+ * memory the kernel actually backed with them.
+ */
+size_t mapped_page_size(const void *address) {
+    size_t base = 4096;
+#ifdef __linux__
+    base = sysconf(_SC_PAGESIZE);
+    unsigned long target = reinterpret_cast<uintptr_t>(address);
+    std::ifstream smaps("/proc/self/smaps");
+    std::string line;
+    bool found = false;
+    while (std::getline(smaps, line)) {
+        // Mappings start with their address range, followed by their fields
+        unsigned long start, end;
+        if (std::sscanf(line.c_str(), "%lx-%lx", &start, &end) == 2) {
+            found = target >= start && target < end;
+        } else if (found && line.rfind("AnonHugePages:", 0) == 0) {
+            size_t kilobytes = 0;
+            std::sscanf(line.c_str(), "AnonHugePages: %zu", &kilobytes);
+            return kilobytes ? huge_page_size() : base;
+        }
+    }
+#endif
+    return base;
+}
+
+/**
+ * Pack an entry into a single word
+ */
+uint64_t pack(const TableEntry &entry) {
+    return uint64_t(uint16_t(entry.score)) |
+           (uint64_t(entry.move) << 16) |
+           (uint64_t(uint8_t(entry.depth)) << 32) |
+           (uint64_t(entry.bound) << 40) |
+           (uint64_t(entry.generation) << 42);
+}
+
+/**
+ * Unpack an entry from a single word
+ */
+TableEntry unpack(uint64_t data) {
+    TableEntry entry;
+    entry.score = int16_t(data & 0xffff);
+    entry.move = (data >> 16) & 0xffff;
+    entry.depth = int8_t((data >> 32) & 0xff);
+    entry.bound = Bound((data >> 40) & 0x3);
+    entry.generation = (data >> 42) & 0xffff;
+    return entry;
+}
+
+TranspositionTable::TranspositionTable(size_t bytes, bool huge_pages) :
+    _buckets(std::max<size_t>(bytes / sizeof(Slot) / bucket_slots, 1)),
+    _page_size(0), _mapped(false), _created(std::chrono::steady_clock::now()) {
+    _size = _buckets * bucket_slots;
+    _bytes = _size * sizeof(Slot);
+#ifdef __linux__
+    size_t huge_size = huge_page_size();
+    size_t rounded = (_bytes + huge_size - 1) / huge_size * huge_size;
+    void *memory = MAP_FAILED;
+
+    // Reserved huge pages first, then transparent huge pages
+    if (huge_pages) {
+        memory = mmap(nullptr,
+                      rounded,
+                      PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB,
+                      -1,
+                      0);
+        if (memory != MAP_FAILED) {
+            _page_size = huge_size;
+        }
+    }
+    if (memory == MAP_FAILED) {
+        memory = mmap(nullptr,
+                      rounded,
+                      PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS,
+                      -1,
+                      0);
+        if (memory != MAP_FAILED && huge_pages) {
+            madvise(memory, rounded, MADV_HUGEPAGE);
+        }
+    }
+    if (memory != MAP_FAILED) {
+        _slots = static_cast<Slot *>(memory);
+        _bytes = rounded;
+        _mapped = true;
+    }
+#endif
+    if (!_mapped) {
+        _slots = static_cast<Slot *>(::operator new(_bytes));
+    }
+
+    // Constructing every slot also faults in every page
+    for (size_t i = 0; i < _size; i++) {
+        new (&_slots[i]) Slot();
+        _slots[i].check.store(0, std::memory_order_relaxed);
+        _slots[i].data.store(0, std::memory_order_relaxed);
+    }
+    if (_page_size == 0) {
+        _page_size = mapped_page_size(_slots);
+    }
+}
+
+TranspositionTable::~TranspositionTable() {
+#ifdef __linux__
+    if (_mapped) {
+        munmap(_slots, _bytes);
+        return;
+    }
+#endif
+    ::operator delete(_slots);
+}
+
+bool TranspositionTable::probe(uint64_t key, TableEntry &entry) {
+    Slot *bucket = &_slots[key % _buckets * bucket_slots];
+    for (size_t i = 0; i < bucket_slots; i++) {
+        uint64_t data = bucket[i].data.load(std::memory_order_relaxed);
+        uint64_t check = bucket[i].check.load(std::memory_order_relaxed);
+        if ((check ^ data) == key) {
+            entry = unpack(data);
+            return true;
+        }
+    }
+    return false;
+}
+
+void TranspositionTable::new_search() {
+    auto elapsed = std::chrono::steady_clock::now() - _created;
+    _generation.store(uint16_t(elapsed / epoch), std::memory_order_relaxed);
+}
+
+void TranspositionTable::store(uint64_t key, const TableEntry &entry) {
+    Slot *bucket = &_slots[key % _buckets * bucket_slots];
+    uint16_t generation = _generation.load(std::memory_order_relaxed);
+
+    // The position's own entry is replaced, otherwise empty slots go first
+    // and then the entry worth least
+    Slot *victim = bucket;
+    int least = INT_MAX;
+    for (size_t i = 0; i < bucket_slots; i++) {
+        uint64_t data = bucket[i].data.load(std::memory_order_relaxed);
+        uint64_t check = bucket[i].check.load(std::memory_order_relaxed);
+        if ((check ^ data) == key) {
+            victim = &bucket[i];
+            break;
+        }
+
+        int worth = INT_MIN;
+        if (data || check) {
+            TableEntry old = unpack(data);
+            worth = old.depth - uint16_t(generation - old.generation);
+        }
+        if (worth < least) {
+            least = worth;
+            victim = &bucket[i];
+        }
+    }
+
+    TableEntry stored = entry;
+    stored.generation = generation;
+    uint64_t data = pack(stored);
+    victim->check.store(key ^ data, std::memory_order_relaxed);
+    victim->data.store(data, std::memory_order_relaxed);
+}
+
+size_t TranspositionTable::memory() {
+    return _bytes;
+}
+
+size_t TranspositionTable::page_size() {
+    return _page_size;
+}
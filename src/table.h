@@ -0,0 +1,103 @@
+#ifndef TABLE_H_
+#define TABLE_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * How a stored score relates to the true score of a position
+ */
+enum class Bound : uint8_t { Exact, Lower, Upper };
+
+/**
+ * Result of searching a position, as stored in the transposition table
+ */
+struct TableEntry {
+    int score = 0;
+
+    // Origin square in the low 6 bits and destination in the next 6
+    uint16_t move = 0;
+    int depth = 0;
+    Bound bound = Bound::Exact;
+
+    // Generation of the table when the entry was stored
+    uint16_t generation = 0;
+};
+
+/**
+ * Transposition table that can be probed and written by many threads at once
+ *
+ * Each slot stores its entry next to the key XOR the entry, both written
+ * without locks. A slot torn by two concurrent writes fails the key check on
+ * probe and reads as a miss.
+ *
+ * One table is shared by the engines of every game. Slots are grouped in
+ * buckets of four, a position may sit in any slot of its bucket and a new
+ * one replaces the entry of least worth. Entries lose a ply of worth for
+ * each generation they have aged, and generations are epochs of wall-clock
+ * time rather than searches, so a game's entries from its last move keep
+ * their worth however many other searches ran since. Generations wrap only
+ * after days, long past the point any entry is worth keeping.
+ */
+class TranspositionTable {
+    struct Slot {
+        std::atomic<uint64_t> check;
+        std::atomic<uint64_t> data;
+    };
+
+    Slot *_slots;
+    size_t _size;
+    size_t _buckets;
+
+    // Bytes mapped for the slots, and the size of the pages backing them
+    size_t _bytes;
+    size_t _page_size;
+    bool _mapped;
+
+    std::chrono::steady_clock::time_point _created;
+    std::atomic<uint16_t> _generation = 0;
+
+  public:
+    /**
+     * Create a table of some size in bytes
+     *
+     * The table is backed by huge pages where the system allows it, which
+     * keeps probes of a large table from missing the TLB. Every page is
+     * touched up front so searches never fault one in.
+     */
+    TranspositionTable(size_t bytes, bool huge_pages = true);
+    ~TranspositionTable();
+
+    TranspositionTable(const TranspositionTable &) = delete;
+    TranspositionTable &operator=(const TranspositionTable &) = delete;
+
+    /**
+     * Bring the table's generation up to date at the start of a search
+     */
+    void new_search();
+
+    /**
+     * Look up a position, returns true if it was found
+     */
+    bool probe(uint64_t key, TableEntry &entry);
+
+    /**
+     * Store the result of searching a position over its earlier entry, or
+     * else the entry of least worth in its bucket
+     */
+    void store(uint64_t key, const TableEntry &entry);
+
+    /**
+     * Get the memory used by the table in bytes
+     */
+    size_t memory();
+
+    /**
+     * Get the size of the pages backing the table in bytes
+     */
+    size_t page_size();
+};
+
+#endif
@@ -0,0 +1,143 @@
+#include "tablebase.h"
+
+#include <algorithm>
+#include <sstream>
+
+#include "engine.h"
+
+#ifdef CHESSAI_SYZYGY
+#include <tbprobe.h>
+
+/**
+ * Occupancy of a position by color and piece type, as Fathom takes it
+ *
+ * Types are indexed from pawn to king, so Fathom's kings are types[5].
+ */
+struct Bitboards {
+    uint64_t white = 0;
+    uint64_t black = 0;
+    uint64_t types[6] = {0, 0, 0, 0, 0, 0};
+    int pieces = 0;
+};
+
+Bitboards get_bitboards(brainiac::Board &board) {
+    Bitboards bitboards;
+    for (int square = 0; square < 64; square++) {
+        brainiac::Piece piece = board.get_at_coords(square / 8, square % 8);
+        if (piece.is_empty()) continue;
+
+        uint64_t bit = uint64_t(1) << square;
+        if (piece.get_color() == brainiac::Color::White) {
+            bitboards.white |= bit;
+        } else {
+            bitboards.black |= bit;
+        }
+        bitboards.types[type_index(piece.get_type())] |= bit;
+        bitboards.pieces++;
+    }
+    return bitboards;
+}
+
+/**
+ * Outcome from the perspective of the side to move
+ */
+int wdl_result(unsigned wdl) {
+    if (wdl == TB_WIN) return 1;
+    if (wdl == TB_LOSS) return -1;
+
+    // Cursed wins and blessed losses are drawn by the fifty-move rule
+    return 0;
+}
+
+Tablebase::Tablebase(std::string paths, int max_pieces) {
+    if (paths.empty() || !tb_init(paths.c_str())) return;
+    _pieces = std::min<int>(max_pieces, TB_LARGEST);
+}
+
+Tablebase::~Tablebase() {
+    tb_free();
+}
+
+bool Tablebase::probe_wdl(brainiac::Board &board, int &result) {
+    if (!_pieces) return false;
+    Bitboards bitboards = get_bitboards(board);
+    if (bitboards.pieces > _pieces) return false;
+
+    unsigned wdl = tb_probe_wdl(bitboards.white,
+                                bitboards.black,
+                                bitboards.types[5],
+                                bitboards.types[4],
+                                bitboards.types[3],
+                                bitboards.types[2],
+                                bitboards.types[1],
+                                bitboards.types[0],
+                                0,
+                                0,
+                                0,
+                                board.get_turn() == brainiac::Color::White);
+    if (wdl == TB_RESULT_FAILED) return false;
+    result = wdl_result(wdl);
+    return true;
+}
+
+brainiac::Move Tablebase::probe_root(brainiac::Board &board, int &result) {
+    if (!_pieces) return brainiac::Move();
+    Bitboards bitboards = get_bitboards(board);
+    if (bitboards.pieces > _pieces) return brainiac::Move();
+
+    // The root can be any position, so the counters come from the FEN
+    std::istringstream fen(board.generate_fen());
+    std::string placement, turn, castling, en_passant;
+    unsigned rule50 = 0;
+    fen >> placement >> turn >> castling >> en_passant >> rule50;
+    if (castling != "-") return brainiac::Move();
+    unsigned ep = 0;
+    if (en_passant.size() == 2) {
+        ep = (en_passant[0] - 'a') + 8 * (en_passant[1] - '1');
+    }
+
+    std::unique_lock<std::mutex> lock(_root_mutex);
+    unsigned root = tb_probe_root(bitboards.white,
+                                  bitboards.black,
+                                  bitboards.types[5],
+                                  bitboards.types[4],
+                                  bitboards.types[3],
+                                  bitboards.types[2],
+                                  bitboards.types[1],
+                                  bitboards.types[0],
+                                  rule50,
+                                  0,
+                                  ep,
+                                  board.get_turn() == brainiac::Color::White,
+                                  nullptr);
+    lock.unlock();
+    if (root == TB_RESULT_FAILED || root == TB_RESULT_CHECKMATE ||
+        root == TB_RESULT_STALEMATE) {
+        return brainiac::Move();
+    }
+    result = wdl_result(TB_GET_WDL(root));
+
+    char promotions[] = {0, 'q', 'r', 'b', 'n'};
+    unsigned promotion = TB_GET_PROMOTES(root);
+    return board.create_move(
+        static_cast<brainiac::Square>(TB_GET_FROM(root)),
+        static_cast<brainiac::Square>(TB_GET_TO(root)),
+        promotion < 5 ? promotions[promotion] : 0);
+}
+#else
+Tablebase::Tablebase(std::string paths, int max_pieces) {}
+
+Tablebase::~Tablebase() {}
+
+bool Tablebase::probe_wdl(brainiac::Board &board, int &result) {
+    return false;
+}
+
+brainiac::Move Tablebase::probe_root(brainiac::Board &board, int &result) {
+    return brainiac::Move();
+}
+#endif
+
+int Tablebase::pieces() {
+    return _pieces;
+}
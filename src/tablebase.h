@@ -0,0 +1,57 @@
+#ifndef TABLEBASE_H_
+#define TABLEBASE_H_
+
+#include <brainiac.h>
+#include <mutex>
+#include <string>
+
+/**
+ * Syzygy endgame tablebases
+ *
+ * Probing goes through Fathom, which maps table files on demand the first
+ * time a material balance is probed. Builds without Fathom get a tablebase
+ * that never finds a position.
+ */
+class Tablebase {
+    int _pieces = 0;
+
+    // Root probes keep their state in Fathom globals, so only one may run
+    std::mutex _root_mutex;
+
+  public:
+    /**
+     * Open the tables under some paths, separated by colons, using tables of
+     * at most some number of pieces
+     */
+    Tablebase(std::string paths, int max_pieces);
+    ~Tablebase();
+
+    Tablebase(const Tablebase &) = delete;
+    Tablebase &operator=(const Tablebase &) = delete;
+
+    /**
+     * Get the largest number of pieces positions can be probed with
+     */
+    int pieces();
+
+    /**
+     * Probe the outcome of a position reached by a capture, from the
+     * perspective of the side to move
+     *
+     * A capture leaves no en passant square and resets the fifty-move
+     * counter, which the tables require. Returns 1 for a win, 0 for a draw
+     * and -1 for a loss, storing it in result only if the position was found.
+     */
+    bool probe_wdl(brainiac::Board &board, int &result);
+
+    /**
+     * Find the move that wins fastest, or loses slowest, at the root of a
+     * search, storing the outcome of the position after it in result
+     *
+     * Returns an invalid move if the position was not found. Probes from
+     * different searches run one at a time.
+     */
+    brainiac::Move probe_root(brainiac::Board &board, int &result);
+};
+
+#endif
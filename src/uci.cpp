@@ -0,0 +1,313 @@
+#include "uci.h"
+
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <poll.h>
+#include <sstream>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/**
+ * Time an engine gets to answer the handshake or quit, in milliseconds
+ */
+constexpr int handshake_timeout = 5000;
+
+/**
+ * Time a search may overrun its budget before it is stopped, and time after a
+ * stop before the engine is considered runaway and killed
+ */
+constexpr std::chrono::milliseconds overrun(1000);
+constexpr std::chrono::milliseconds grace(2000);
+
+/**
+ * Convert a move in UCI notation to a move on a board
+ */
+brainiac::Move parse_move(brainiac::Board &board, const std::string &move) {
+    if (move.size() < 4) return brainiac::Move();
+    char promotion = move.size() > 4 ? move[4] : 0;
+    return board.create_move(brainiac::string_to_square(move.substr(0, 2)),
+                             brainiac::string_to_square(move.substr(2, 2)),
+                             promotion);
+}
+
+UciProcess::UciProcess(std::string command) : _command(command) {}
+
+UciProcess::~UciProcess() {
+    stop();
+}
+
+bool UciProcess::start() {
+    int input[2];
+    int output[2];
+    if (pipe(input) < 0) return false;
+    if (pipe(output) < 0) {
+        close(input[0]);
+        close(input[1]);
+        return false;
+    }
+
+    _pid = fork();
+    if (_pid == 0) {
+        dup2(input[0], STDIN_FILENO);
+        dup2(output[1], STDOUT_FILENO);
+        close(input[0]);
+        close(input[1]);
+        close(output[0]);
+        close(output[1]);
+        execl("/bin/sh", "sh", "-c", _command.c_str(), nullptr);
+        _exit(127);
+    }
+    close(input[0]);
+    close(output[1]);
+    if (_pid < 0) {
+        close(input[1]);
+        close(output[0]);
+        return false;
+    }
+    _input = input[1];
+    _output = output[0];
+    _buffer.clear();
+    game_id = 0;
+
+    if (!send("uci\n") || !expect("uciok", handshake_timeout) ||
+        !send("isready\n") || !expect("readyok", handshake_timeout)) {
+        stop();
+        return false;
+    }
+    return true;
+}
+
+void UciProcess::stop() {
+    if (_pid <= 0) return;
+    send("quit\n");
+    close(_input);
+
+    // Give the engine a moment to quit before killing it
+    int status;
+    auto deadline = std::chrono::steady_clock::now() +
+                    std::chrono::milliseconds(handshake_timeout);
+    while (waitpid(_pid, &status, WNOHANG) == 0) {
+        if (std::chrono::steady_clock::now() > deadline) {
+            kill(_pid, SIGKILL);
+            waitpid(_pid, &status, 0);
+            break;
+        }
+        usleep(10000);
+    }
+    close(_output);
+    _pid = -1;
+    _input = -1;
+    _output = -1;
+}
+
+bool UciProcess::alive() {
+    if (_pid <= 0) return false;
+    int status;
+    if (waitpid(_pid, &status, WNOHANG) == 0) return true;
+
+    // Already reaped, so only the pipes are left to close
+    close(_input);
+    close(_output);
+    _pid = -1;
+    _input = -1;
+    _output = -1;
+    return false;
+}
+
+bool UciProcess::send(const std::string &lines) {
+    size_t written = 0;
+    while (written < lines.size()) {
+        ssize_t count =
+            write(_input, lines.data() + written, lines.size() - written);
+        if (count <= 0) return false;
+        written += count;
+    }
+    return true;
+}
+
+bool UciProcess::read_line(std::string &line, int timeout_ms) {
+    while (true) {
+        size_t end = _buffer.find('\n');
+        if (end != std::string::npos) {
+            line = _buffer.substr(0, end);
+            if (line.size() && line.back() == '\r') line.pop_back();
+            _buffer.erase(0, end + 1);
+            return true;
+        }
+
+        pollfd descriptor = {_output, POLLIN, 0};
+        if (poll(&descriptor, 1, timeout_ms) <= 0) return false;
+        char chunk[4096];
+        ssize_t count = read(_output, chunk, sizeof(chunk));
+        if (count <= 0) {
+            // The engine closed its output, so it is gone or about to be
+            stop();
+            return false;
+        }
+        _buffer.append(chunk, count);
+    }
+}
+
+bool UciProcess::expect(std::string token, int timeout_ms) {
+    std::string line;
+    while (read_line(line, timeout_ms)) {
+        if (line.rfind(token, 0) == 0) return true;
+    }
+    return false;
+}
+
+UciBackend::UciBackend(std::string command, int processes) {
+    // Writing to a crashed engine must fail the write, not end the bot
+    std::signal(SIGPIPE, SIG_IGN);
+
+    for (int i = 0; i < std::max(processes, 1); i++) {
+        _processes.push_back(std::make_unique<UciProcess>(command));
+        _processes.back()->start();
+        _idle.push_back(_processes.back().get());
+    }
+}
+
+UciProcess &UciBackend::acquire(uint64_t game_id) {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _returned.wait(lock, [this]() { return !_idle.empty(); });
+
+    // Prefer the engine that already knows the game
+    auto it = _idle.begin();
+    for (auto idle = _idle.begin(); idle != _idle.end(); idle++) {
+        if ((*idle)->game_id == game_id) {
+            it = idle;
+            break;
+        }
+    }
+    UciProcess &process = **it;
+    _idle.erase(it);
+    return process;
+}
+
+void UciBackend::restore(UciProcess &process) {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _idle.push_back(&process);
+    }
+    _returned.notify_one();
+}
+
+SearchResult UciBackend::search(uint64_t game_id,
+                                brainiac::Board board,
+                                SearchLimits limits) {
+    auto start = std::chrono::steady_clock::now();
+    SearchResult result;
+    UciProcess &process = acquire(game_id);
+    if (!process.alive() && !process.start()) {
+        restore(process);
+        return result;
+    }
+
+    // The position and search are sent together without waiting for the
+    // engine in between
+    std::string commands;
+    if (process.game_id != game_id) {
+        commands += "ucinewgame\n";
+        process.game_id = game_id;
+    }
+    commands += "position fen " + board.generate_fen() + "\n";
+    commands += "go depth " + std::to_string(limits.depth);
+    if (limits.nodes) {
+        commands += " nodes " + std::to_string(limits.nodes);
+    }
+    if (limits.time.count()) {
+        commands += " movetime " + std::to_string(limits.time.count());
+    }
+    commands += "\n";
+
+    bool stopped = false;
+    auto stopped_at = start;
+    std::vector<std::string> pv;
+    std::string best;
+    std::string line;
+    while (process.send(commands)) {
+        commands.clear();
+
+        // Stop on cancellation or once the budget is overrun, and give up on
+        // an engine that ignores the stop. Checked before every read, as an
+        // engine may print lines without ever going quiet.
+        auto now = std::chrono::steady_clock::now();
+        bool overrunning =
+            limits.time.count() && now - start > limits.time + overrun;
+        bool cancelled = (limits.stop && limits.stop->load()) ||
+                         (limits.yield && limits.yield->load());
+        if (!stopped && (overrunning || cancelled)) {
+            commands = "stop\n";
+            stopped = true;
+            stopped_at = now;
+            continue;
+        }
+        if (stopped && now - stopped_at > grace) {
+            process.stop();
+            break;
+        }
+
+        if (!process.read_line(line, 50)) {
+            if (!process.alive()) break;
+            continue;
+        }
+
+        std::istringstream tokens(line);
+        std::string token;
+        tokens >> token;
+        if (token == "bestmove") {
+            tokens >> best;
+            break;
+        }
+        if (token != "info") continue;
+        while (tokens >> token) {
+            if (token == "depth") {
+                tokens >> result.depth;
+            } else if (token == "nodes") {
+                tokens >> result.nodes;
+            } else if (token == "score") {
+                std::string kind;
+                int value;
+                tokens >> kind >> value;
+                if (kind == "cp") {
+                    result.score = value;
+                } else if (kind == "mate") {
+                    result.score = value > 0 ? mate_score - (2 * value - 1)
+                                             : -mate_score - 2 * value;
+                }
+            } else if (token == "pv") {
+                pv.clear();
+                while (tokens >> token) {
+                    pv.push_back(token);
+                }
+            }
+        }
+    }
+    restore(process);
+
+    // Replay the line to turn it into moves of the board
+    result.move = parse_move(board, best);
+    if (pv.empty() || pv[0] != best) {
+        pv = {best};
+    }
+    for (std::string &move : pv) {
+        brainiac::Move parsed = parse_move(board, move);
+        if (parsed.is_invalid()) break;
+        result.pv.push_back(parsed);
+        board.make_move(parsed);
+    }
+    result.seconds = std::chrono::duration<double>(
+                         std::chrono::steady_clock::now() - start)
+                         .count();
+    return result;
+}
+
+void UciBackend::release(uint64_t game_id) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (UciProcess *process : _idle) {
+        if (process->game_id == game_id) {
+            process->game_id = 0;
+        }
+    }
+}
@@ -0,0 +1,103 @@
+#ifndef UCI_H_
+#define UCI_H_
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <sys/types.h>
+#include <vector>
+
+#include "backend.h"
+
+/**
+ * Engine subprocess spoken to over UCI through its standard input and output
+ */
+class UciProcess {
+    std::string _command;
+    pid_t _pid = -1;
+
+    // Ends of the pipes to the engine's input and from its output
+    int _input = -1;
+    int _output = -1;
+
+    // Output read but not yet split into lines
+    std::string _buffer;
+
+    /**
+     * Wait for a line starting with some token, returns false on timeout or
+     * if the engine exited
+     */
+    bool expect(std::string token, int timeout_ms);
+
+  public:
+    // Game the engine last searched, its hash is cleared on a new game
+    uint64_t game_id = 0;
+
+    UciProcess(std::string command);
+    ~UciProcess();
+
+    /**
+     * Launch the engine and complete the UCI handshake
+     */
+    bool start();
+
+    /**
+     * Ask the engine to quit, killing it if it does not
+     */
+    void stop();
+
+    /**
+     * Test if the engine is running
+     */
+    bool alive();
+
+    /**
+     * Send commands, each line terminated by a newline
+     */
+    bool send(const std::string &lines);
+
+    /**
+     * Read a line of output, returns false on timeout or if the engine exited
+     */
+    bool read_line(std::string &line, int timeout_ms);
+};
+
+/**
+ * Backend running searches on a pool of long-lived UCI engine subprocesses
+ *
+ * A crashed or runaway engine only fails its own search, it is restarted on
+ * its next one. Searches prefer the engine that searched the same game last,
+ * whose hash table is still warm.
+ */
+class UciBackend : public EngineBackend {
+    std::vector<std::unique_ptr<UciProcess>> _processes;
+    std::vector<UciProcess *> _idle;
+
+    std::mutex _mutex;
+    std::condition_variable _returned;
+
+    /**
+     * Take an idle engine, waiting if there is none
+     */
+    UciProcess &acquire(uint64_t game_id);
+
+    /**
+     * Return an engine to the idle list
+     */
+    void restore(UciProcess &process);
+
+  public:
+    /**
+     * Start some number of engines running a shell command
+     */
+    UciBackend(std::string command, int processes);
+
+    SearchResult search(uint64_t game_id,
+                        brainiac::Board board,
+                        SearchLimits limits) override;
+
+    void release(uint64_t game_id) override;
+};
+
+#endif